@@ -2,7 +2,11 @@
 #include "libretro-core.h"
 #include "libretro-mapper.h"
 #include "libretro-graph.h"
+#include "libretro-rewind.h"
+#include "libretro-memvfs.h"
+#include "libretro-metacache.h"
 #include "encodings/utf.h"
+#include "features/features_cpu.h"
 
 #include "archdep.h"
 #include "mem.h"
@@ -42,6 +46,8 @@
 /* Main CPU loop */
 long retro_now = 0;
 unsigned retro_renderloop = 1;
+bool retro_skip_video = false;
+static bool retro_skip_audio = false;
 
 /* VKBD */
 extern bool retro_vkbd;
@@ -62,6 +68,9 @@ struct vice_raster_s vice_raster;
 static snapshot_stream_t* snapshot_stream = NULL;
 static int load_trap_happened = 0;
 static int save_trap_happened = 0;
+/* CPU loop has returned at the end of a frame, between instructions with
+ * registers exported, and has not been entered since */
+static bool retro_frame_edge = false;
 
 unsigned int retro_devices[RETRO_DEVICES] = {0};
 unsigned int opt_video_options_display = 0;
@@ -112,12 +121,19 @@ static bool pix_bytes_initialized = false;
 unsigned short int retro_bmp[RETRO_BMP_SIZE] = {0};
 unsigned int retro_bmp_offset = 0;
 
-/* Audio output buffer */
+/* Last submitted frame layout, a change needs a full frame */
+static unsigned int video_prev_offset = 0;
+static unsigned int video_prev_width  = 0;
+static unsigned int video_prev_height = 0;
+static unsigned int video_prev_pitch  = 0;
+
+/* Audio flushed outside retro_run(), held until the next one */
 static struct {
    int16_t *data;
    int32_t size;
    int32_t capacity;
-} output_audio_buffer = {NULL, 0, 0};
+} pending_audio_buffer = {NULL, 0, 0};
+static bool retro_run_active = false;
 
 /* Audio buffer copy for auto warp detection */
 int16_t *audio_buffer;
@@ -168,7 +184,14 @@ static bool opt_model_auto_locked = false;
 unsigned int opt_autostart = 1;
 unsigned int opt_autoloadwarp = 0;
 unsigned int opt_warp_boost = 1;
+unsigned int opt_sid_render = 0;
+static unsigned int opt_warp_budget = 500;
 unsigned int opt_read_vicerc = 0;
+static unsigned int opt_rewind_size = 0;
+static unsigned int opt_runahead = 0;
+static void runahead_free(void);
+static bool runahead_allowed(void);
+static void runahead_run(unsigned int frames);
 unsigned int opt_work_disk_type = 0;
 unsigned int opt_work_disk_unit = 8;
 #if defined(__X64__) || defined(__X64SC__) || defined(__X128__) || defined(__XSCPU64__)
@@ -237,6 +260,7 @@ void retro_set_input_poll(retro_input_poll_t cb) { input_poll_cb = cb; }
 static struct retro_perf_callback perf_cb;
 
 bool libretro_supports_bitmasks = false;
+static bool libretro_can_dupe = false;
 static bool libretro_supports_ff_override = false;
 bool libretro_ff_enabled = false;
 static bool libretro_supports_option_categories = false;
@@ -454,6 +478,11 @@ static int vic20_autodetect_cartridge_type(const char* argv)
    FILE *fd;
    int addr = 0, len = 0, type = 0;
    char buf[RETRO_PATH_MAX] = {0};
+   /* Name the type is guessed from, the first M3U entry for playlists */
+   const char *name = argv;
+
+   if (metacache_get_int(argv, METACACHE_CART_TYPE, 0, &type))
+      return type;
 
    fd = fopen(argv, MODE_READ);
    fseek(fd, 0, SEEK_END);
@@ -479,7 +508,7 @@ static int vic20_autodetect_cartridge_type(const char* argv)
             if (fgets(buf, sizeof(buf), fd) != NULL)
             {
                buf[strcspn(buf, "\r\n")] = 0;
-               argv = buf;
+               name = buf;
             }
          }
          break;
@@ -506,22 +535,23 @@ static int vic20_autodetect_cartridge_type(const char* argv)
          type = CARTRIDGE_VIC20_8KB_A000;
    }
 
-   if (strcasestr(argv, ".20"))
+   if (strcasestr(name, ".20"))
       type = CARTRIDGE_VIC20_16KB_2000;
-   else if (strcasestr(argv, ".40"))
+   else if (strcasestr(name, ".40"))
       type = CARTRIDGE_VIC20_16KB_4000;
-   else if (strcasestr(argv, ".60"))
+   else if (strcasestr(name, ".60"))
       type = CARTRIDGE_VIC20_16KB_6000;
-   else if (strcasestr(argv, ".70"))
+   else if (strcasestr(name, ".70"))
       type = CARTRIDGE_VIC20_4KB_6000;
-   else if (strcasestr(argv, ".a0"))
+   else if (strcasestr(name, ".a0"))
       type = CARTRIDGE_VIC20_8KB_A000;
-   else if (strcasestr(argv, ".b0"))
+   else if (strcasestr(name, ".b0"))
       type = CARTRIDGE_VIC20_4KB_B000;
 
    /* Multipart ROM combinations (type < 0) */
-   type = vic20_cart_is_multipart(type, argv);
+   type = vic20_cart_is_multipart(type, name);
 
+   metacache_set_int(argv, METACACHE_CART_TYPE, 0, type);
    return type;
 }
 
@@ -752,21 +782,21 @@ static int process_cmdline(const char* argv)
          snprintf(zip_m3u_list.path, sizeof(zip_m3u_list.path), "%s%s%s.m3u",
                retro_temp_directory, FSDEV_DIR_SEP_STR, utf8_to_local_string_alloc(zip_basename));
 
-         DIR *zip_dir;
-         struct dirent *zip_dirp;
+         memvfs_dir_t *zip_dir;
+         char *zip_name;
 
          /* Convert all NIBs to G64 */
-         zip_dir = opendir(retro_temp_directory);
-         while ((zip_dirp = readdir(zip_dir)) != NULL)
+         zip_dir = memvfs_opendir(retro_temp_directory);
+         while ((zip_name = memvfs_readdir(zip_dir)) != NULL)
          {
-            if (dc_get_image_type(zip_dirp->d_name) == DC_IMAGE_TYPE_NIBBLER)
+            if (dc_get_image_type(zip_name) == DC_IMAGE_TYPE_NIBBLER)
             {
-               snprintf(nib_input, sizeof(nib_input), "%s%s%s", retro_temp_directory, FSDEV_DIR_SEP_STR, zip_dirp->d_name);
-               snprintf(nib_output, sizeof(nib_output), "%s%s%s.g64", retro_temp_directory, FSDEV_DIR_SEP_STR, path_remove_extension(zip_dirp->d_name));
+               snprintf(nib_input, sizeof(nib_input), "%s%s%s", retro_temp_directory, FSDEV_DIR_SEP_STR, zip_name);
+               snprintf(nib_output, sizeof(nib_output), "%s%s%s.g64", retro_temp_directory, FSDEV_DIR_SEP_STR, path_remove_extension(zip_name));
                nib_convert(nib_input, nib_output);
             }
          }
-         closedir(zip_dir);
+         memvfs_closedir(zip_dir);
 
          if (string_is_empty(browsed_file))
             m3u_scan_recurse(retro_temp_directory, &zip_m3u_list);
@@ -781,6 +811,11 @@ static int process_cmdline(const char* argv)
                   else
                      snprintf(full_path, sizeof(full_path), "%s%s%s", retro_temp_directory, FSDEV_DIR_SEP_STR, browsed_file);
                }
+               else
+               {
+                  /* FileSystem device reads and writes the directory itself */
+                  memvfs_export();
+               }
                break;
             case 1: /* Generated playlist */
                zip_m3u = fopen(zip_m3u_list.path, "w");
@@ -1846,40 +1881,6 @@ void reload_restart(void)
    update_from_vice();
 }
 
-/* Audio buffer */
-static void ensure_output_audio_buffer_capacity(int32_t capacity)
-{
-   if (capacity <= output_audio_buffer.capacity) {
-      return;
-   }
-
-   output_audio_buffer.data = realloc(output_audio_buffer.data, capacity * sizeof(*output_audio_buffer.data));
-   output_audio_buffer.capacity = capacity;
-   log_cb(RETRO_LOG_DEBUG, "Output audio buffer capacity set to %d\n", capacity);
-}
-
-static void init_output_audio_buffer(int32_t capacity)
-{
-   output_audio_buffer.data = NULL;
-   output_audio_buffer.size = 0;
-   output_audio_buffer.capacity = 0;
-   ensure_output_audio_buffer_capacity(capacity);
-}
-
-static void free_output_audio_buffer()
-{
-   free(output_audio_buffer.data);
-   output_audio_buffer.data = NULL;
-   output_audio_buffer.size = 0;
-   output_audio_buffer.capacity = 0;
-}
-
-static void upload_output_audio_buffer()
-{
-   audio_batch_cb(output_audio_buffer.data, output_audio_buffer.size / 2);
-   output_audio_buffer.size = 0;
-}
-
 /* FPS counter + mapper tick */
 long retro_ticks(void)
 {
@@ -1955,6 +1956,61 @@ bool is_audio_playing_while_autoloadwarping(void)
    return (audio_is_playing && !retro_warpmode && !(opt_autoloadwarp & AUTOLOADWARP_MUTE));
 }
 
+bool retro_cartridge_attached(void)
+{
+#if defined(__X64__) || defined(__X64SC__) || defined(__XSCPU64__) || defined(__X128__)
+   return !string_is_empty(cartridge_get_file_name(cart_getid_slotmain()));
+#elif defined(__XVIC__)
+   return !string_is_empty(generic_get_file_name(0));
+#else
+   return !string_is_empty(cartridge_get_file_name(0));
+#endif
+}
+
+/* Warp mode frame batching, emulation speed as EWMA of cycles per microsecond */
+#define WARP_SPEED_WEIGHT 0.25
+static double warp_cycles_per_usec = 0;
+
+static int64_t warp_time_usec(void)
+{
+   /* Wall time, process CPU time would include the SID threads */
+   if (perf_cb.get_time_usec)
+      return perf_cb.get_time_usec();
+   return cpu_features_get_time_usec();
+}
+
+static bool warp_batching(void)
+{
+   return retro_warp_mode_enabled() && !is_audio_playing_while_autoloadwarping();
+}
+
+/* Measure the frame just emulated, and tell if another one fits the budget */
+static bool warp_next_frame(int64_t start, int64_t frame_start, CLOCK frame_clk)
+{
+   int64_t now       = warp_time_usec();
+   int64_t elapsed   = now - frame_start;
+   CLOCK frame_clks  = maincpu_clk - frame_clk;
+   int64_t budget    = (int64_t)(1000000 / retro_refresh) * opt_warp_budget / 100;
+
+   if (elapsed > 0 && maincpu_clk > frame_clk)
+   {
+      double speed = (double)frame_clks / elapsed;
+      if (warp_cycles_per_usec > 0)
+         warp_cycles_per_usec += (speed - warp_cycles_per_usec) * WARP_SPEED_WEIGHT;
+      else
+         warp_cycles_per_usec = speed;
+   }
+
+   if (!warp_batching())
+      return false;
+
+   /* Timer granularity may not see a single frame yet */
+   if (warp_cycles_per_usec <= 0)
+      return (now - start < budget);
+
+   return (now - start + frame_clks / warp_cycles_per_usec <= budget);
+}
+
 static void retro_set_paths(void)
 {
    const char *system_dir = NULL;
@@ -2445,6 +2501,41 @@ static void retro_set_core_options()
          },
          "enabled"
       },
+      {
+         "vice_rewind",
+         "System > In-Core Rewind",
+         "In-Core Rewind",
+         "Keep a compressed rewind history of the given size, stepped back with the 'Hold Rewind' hotkey. Independent of frontend rewind, which should be disabled.",
+         NULL,
+         "system",
+         {
+            { "disabled", NULL },
+            { "4", "4MB" },
+            { "8", "8MB" },
+            { "16", "16MB" },
+            { "32", "32MB" },
+            { "64", "64MB" },
+            { NULL, NULL },
+         },
+         "disabled"
+      },
+      {
+         "vice_runahead",
+         "System > Run-Ahead",
+         "Run-Ahead",
+         "Emulate frames ahead and roll back each frame to cut input latency. Every frame costs one extra snapshot and the given amount of extra emulation. Independent of frontend run-ahead, which should be disabled.",
+         NULL,
+         "system",
+         {
+            { "disabled", NULL },
+            { "1", "1 frame" },
+            { "2", "2 frames" },
+            { "3", "3 frames" },
+            { "4", "4 frames" },
+            { NULL, NULL },
+         },
+         "disabled"
+      },
 #if !defined(__X64DTV__)
       {
          "vice_reset",
@@ -2527,6 +2618,25 @@ static void retro_set_core_options()
          },
          "enabled"
       },
+      {
+         "vice_warp_budget",
+         "Media > Warp Time Budget",
+         "Warp Time Budget",
+         "Share of a host frame spent emulating while warping. Higher values warp faster, lower values keep the frontend more responsive.",
+         NULL,
+         "media",
+         {
+            { "50", "50%" },
+            { "75", "75%" },
+            { "100", "100%" },
+            { "150", "150%" },
+            { "200", "200%" },
+            { "300", "300%" },
+            { "500", "500%" },
+            { NULL, NULL },
+         },
+         "500"
+      },
       {
          "vice_drive_true_emulation",
          "Media > True Drive Emulation",
@@ -3317,6 +3427,23 @@ static void retro_set_core_options()
          },
          "disabled"
       },
+#if defined(__X64__) || defined(__X64SC__) || defined(__XSCPU64__) || defined(__X128__)
+      {
+         "vice_sid_render",
+         "Audio > SID Rendering",
+         "SID Rendering",
+         "'Per Frame' renders the SID once per frame instead of on every register write, replaying the writes at their exact cycles. 'Threaded' also renders each SID on its own thread, useful with 'SID Extra' on multi-core devices. Output is identical.",
+         NULL,
+         "audio",
+         {
+            { "write", "Per Write" },
+            { "frame", "Per Frame" },
+            { "threaded", "Threaded" },
+            { NULL, NULL },
+         },
+         "write"
+      },
+#endif
 #endif
       {
          "vice_resid_sampling",
@@ -3799,6 +3926,16 @@ static void retro_set_core_options()
          {{ NULL, NULL }},
          ""
       },
+      {
+         "vice_mapper_rewind",
+         "Hotkey > Hold Rewind",
+         "Hold Rewind",
+         "Hold the mapped key to step back through the history of 'In-Core Rewind'.",
+         NULL,
+         "hotkey",
+         {{ NULL, NULL }},
+         ""
+      },
 #if defined(__X64__) || defined(__X64SC__) || defined(__X64DTV__) || defined(__X128__) || defined(__XSCPU64__) || defined(__XCBM5x0__) || defined(__XVIC__) || defined(__XPLUS4__)
       {
          "vice_mapper_aspect_ratio_toggle",
@@ -4293,6 +4430,7 @@ static void retro_set_core_options()
             || strstr(option_defs_us[i].key, "vice_mapper_aspect_ratio_toggle")
             || strstr(option_defs_us[i].key, "vice_mapper_zoom_mode_toggle")
             || strstr(option_defs_us[i].key, "vice_mapper_warp_mode")
+            || strstr(option_defs_us[i].key, "vice_mapper_rewind")
             || strstr(option_defs_us[i].key, "vice_mapper_turbo_fire_toggle")
             || strstr(option_defs_us[i].key, "vice_mapper_save_disk_toggle")
             || strstr(option_defs_us[i].key, "vice_mapper_datasette_toggle_hotkeys")
@@ -4796,6 +4934,8 @@ void retro_set_options_display(void)
    environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
    option_display.key = "vice_mapper_warp_mode";
    environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
+   option_display.key = "vice_mapper_rewind";
+   environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
    option_display.key = "vice_mapper_turbo_fire_toggle";
    environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
    option_display.key = "vice_mapper_save_disk_toggle";
@@ -4835,6 +4975,10 @@ void retro_set_options_display(void)
    environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
    option_display.key = "vice_sid_extra";
    environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
+#if defined(__X64__) || defined(__X64SC__) || defined(__XSCPU64__) || defined(__X128__)
+   option_display.key = "vice_sid_render";
+   environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
+#endif
    option_display.key = "vice_resid_sampling";
    environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
    option_display.key = "vice_resid_passband";
@@ -5000,8 +5144,10 @@ void retro_set_environment(retro_environment_t cb)
    struct retro_vfs_interface_info vfs_iface_info;
    vfs_iface_info.required_interface_version = 1;
    vfs_iface_info.iface                      = NULL;
-   if (environ_cb(RETRO_ENVIRONMENT_GET_VFS_INTERFACE, &vfs_iface_info))
-      filestream_vfs_init(&vfs_iface_info);
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_VFS_INTERFACE, &vfs_iface_info))
+      vfs_iface_info.iface = NULL;
+   /* Temp directory lives in memory, the rest goes to the frontend VFS */
+   memvfs_init(retro_temp_directory, &vfs_iface_info);
 #endif
 }
 
@@ -5214,6 +5360,13 @@ static void update_variables(void)
       else                                opt_warp_boost = 1;
    }
 
+   var.key = "vice_warp_budget";
+   var.value = NULL;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      opt_warp_budget = atoi(var.value);
+   }
+
    var.key = "vice_drive_true_emulation";
    var.value = NULL;
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
@@ -5801,6 +5954,17 @@ static void update_variables(void)
       vice_opt.SidExtra = sid_extra;
    }
 
+#if defined(__X64__) || defined(__X64SC__) || defined(__XSCPU64__) || defined(__X128__)
+   var.key = "vice_sid_render";
+   var.value = NULL;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if      (!strcmp(var.value, "frame"))    opt_sid_render = SID_RENDER_FRAME;
+      else if (!strcmp(var.value, "threaded")) opt_sid_render = SID_RENDER_THREADED;
+      else                                     opt_sid_render = SID_RENDER_CYCLE;
+   }
+#endif
+
    var.key = "vice_resid_sampling";
    var.value = NULL;
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
@@ -6588,6 +6752,27 @@ static void update_variables(void)
          request_reload_restart = (opt_read_vicerc != opt_read_vicerc_prev) ? true : request_reload_restart;
    }
 
+   var.key = "vice_rewind";
+   var.value = NULL;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (!strcmp(var.value, "disabled")) opt_rewind_size = 0;
+      else                                opt_rewind_size = atoi(var.value);
+
+      rewind_init(opt_rewind_size * 1024 * 1024);
+   }
+
+   var.key = "vice_runahead";
+   var.value = NULL;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (!strcmp(var.value, "disabled")) opt_runahead = 0;
+      else                                opt_runahead = atoi(var.value);
+
+      if (!opt_runahead)
+         runahead_free();
+   }
+
 #if defined(__XSCPU64__)
    var.key = "vice_supercpu_speed_switch";
    var.value = NULL;
@@ -6855,6 +7040,13 @@ static void update_variables(void)
       mapper_keys[RETRO_MAPPER_WARP_MODE] = retro_keymap_id(var.value);
    }
 
+   var.key = "vice_mapper_rewind";
+   var.value = NULL;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      mapper_keys[RETRO_MAPPER_REWIND] = retro_keymap_id(var.value);
+   }
+
    var.key = "vice_mapper_turbo_fire_toggle";
    var.value = NULL;
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
@@ -7213,6 +7405,7 @@ void retro_reset(void)
 
    /* Trigger autostart-reset in retro_run() */
    request_restart = true;
+   rewind_reset();
 }
 
 static void fallback_log(enum retro_log_level level, const char *fmt, ...)
@@ -7235,10 +7428,12 @@ void retro_init(void)
       perf_cb.get_time_usec = NULL;
 
    retro_set_paths();
+   metacache_init(retro_save_directory);
 
    /* Clean ZIP temp */
    if (!string_is_empty(retro_temp_directory) && path_is_directory(retro_temp_directory))
       remove_recurse(retro_temp_directory);
+   memvfs_clear();
 
    /* Disk Control interface */
    dc = dc_create();
@@ -7290,6 +7485,9 @@ void retro_init(void)
    if (environ_cb(RETRO_ENVIRONMENT_GET_INPUT_BITMASKS, NULL))
       libretro_supports_bitmasks = true;
 
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE, &libretro_can_dupe))
+      libretro_can_dupe = false;
+
    if (environ_cb(RETRO_ENVIRONMENT_SET_FASTFORWARDING_OVERRIDE, NULL))
       libretro_supports_ff_override = true;
 
@@ -7311,7 +7509,6 @@ void retro_init(void)
    environ_cb(RETRO_ENVIRONMENT_SET_SUPPORT_ACHIEVEMENTS, &achievements);
 
    memset(retro_bmp, 0, sizeof(retro_bmp));
-   init_output_audio_buffer(2048);
 
    retro_ui_finalized = false;
    update_variables();
@@ -7335,15 +7532,31 @@ void retro_deinit(void)
    /* Clean ZIP temp */
    if (!string_is_empty(retro_temp_directory) && path_is_directory(retro_temp_directory))
       remove_recurse(retro_temp_directory);
+   memvfs_clear();
+
+   /* Write back probe results */
+   metacache_flush();
+   metacache_free();
 
    /* Free buffers uses by libretro-graph */
    libretro_graph_free();
 
-   /* Free audio buffer */
-   free_output_audio_buffer();
+   /* Free held audio */
+   free(pending_audio_buffer.data);
+   pending_audio_buffer.data     = NULL;
+   pending_audio_buffer.size     = 0;
+   pending_audio_buffer.capacity = 0;
+
+   /* Stop SID render threads */
+   sid_sound_machine_render_shutdown();
+
+   /* Free rewind history */
+   rewind_deinit();
+   runahead_free();
 
    /* 'Reset' troublesome static variables */
    libretro_supports_bitmasks = false;
+   libretro_can_dupe = false;
    libretro_supports_ff_override = false;
    libretro_supports_option_categories = false;
    pix_bytes_initialized = false;
@@ -7753,17 +7966,11 @@ void retro_set_audio_sample_batch(retro_audio_sample_batch_t cb)
 
 #define RETRO_AUDIO_BATCH
 
-void retro_audio_queue(const int16_t *data, int32_t samples)
+static void retro_audio_submit(const int16_t *data, int32_t samples)
 {
-   if ((samples < 1) || !runstate)
-      return;
-
 #if ARCHDEP_SOUND_OUTPUT_MODE == SOUND_OUTPUT_STEREO
 #ifdef RETRO_AUDIO_BATCH
-   if (output_audio_buffer.capacity - output_audio_buffer.size < samples)
-      ensure_output_audio_buffer_capacity((output_audio_buffer.capacity + samples) * 1.5);
-   memcpy(output_audio_buffer.data + output_audio_buffer.size, data, samples * sizeof(*output_audio_buffer.data));
-   output_audio_buffer.size += samples;
+   audio_batch_cb(data, samples / 2);
 #else
    for (int x = 0; x < samples; x += 2) audio_cb(data[x], data[x + 1]);
 #endif
@@ -7772,6 +7979,44 @@ void retro_audio_queue(const int16_t *data, int32_t samples)
 #endif
 }
 
+static void retro_audio_submit_pending(void)
+{
+   if (!pending_audio_buffer.size)
+      return;
+
+   retro_audio_submit(pending_audio_buffer.data, pending_audio_buffer.size);
+   pending_audio_buffer.size = 0;
+}
+
+void retro_audio_queue(const int16_t *data, int32_t samples)
+{
+   if ((samples < 1) || !runstate || retro_skip_audio)
+      return;
+
+   /* Straight from the VICE sound buffer, no intermediate copy. The audio
+    * callbacks are only valid inside retro_run(), sound is also flushed when
+    * loading content and by traps, which is held until the next frame */
+   if (retro_run_active)
+   {
+      retro_audio_submit(data, samples);
+      return;
+   }
+
+   if (pending_audio_buffer.capacity - pending_audio_buffer.size < samples)
+   {
+      int32_t capacity = (pending_audio_buffer.size + samples) * 1.5;
+      int16_t *buffer  = realloc(pending_audio_buffer.data, capacity * sizeof(*pending_audio_buffer.data));
+
+      if (!buffer)
+         return;
+      pending_audio_buffer.data     = buffer;
+      pending_audio_buffer.capacity = capacity;
+   }
+
+   memcpy(pending_audio_buffer.data + pending_audio_buffer.size, data, samples * sizeof(*pending_audio_buffer.data));
+   pending_audio_buffer.size += samples;
+}
+
 void emu_model_set(int model)
 {
 #if defined(__X64__) || defined(__X64SC__) || defined(__XSCPU64__) || defined(__XVIC__)
@@ -7809,8 +8054,22 @@ void emu_model_set(int model)
    request_model_prev = model;
 }
 
+/* Emulate until the end of the current frame */
+static void retro_run_frame(void)
+{
+   retro_frame_edge = false;
+   while (retro_renderloop)
+      maincpu_mainloop();
+   retro_renderloop = 1;
+   retro_frame_edge = true;
+}
+
 void retro_run(void)
 {
+   /* Audio held from outside retro_run() goes out first */
+   retro_run_active = true;
+   retro_audio_submit_pending();
+
    /* Core options */
    bool updated = false;
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated) && updated)
@@ -7954,24 +8213,39 @@ void retro_run(void)
    input_poll_cb();
    retro_poll_event();
 
-   /* Main loop with Warp Mode maximizing without too much input lag */
-   unsigned int frame_max = retro_warp_mode_enabled() ? retro_refresh : 1;
-   unsigned int frame_time = 0;
+   /* In-core rewind, restored frame gets rerun for output */
+   if (retro_rewinding)
+      rewind_step();
+
+   /* Main loop with Warp Mode batching as many frames as fit the time budget */
+   unsigned int frame_max = warp_batching() ? retro_refresh : 1;
+   int64_t warp_start = (frame_max > 1) ? warp_time_usec() : 0;
+   bool runahead = runahead_allowed();
    retro_now += 1000000 / retro_refresh;
 
+   /* Real frame is not shown when running ahead */
+   retro_skip_video  = runahead;
+   retro_frame_dirty = false;
+
    for (int frame_count = 0; frame_count < frame_max; ++frame_count)
    {
-      frame_time = retro_ticks();
-      while (retro_renderloop)
-         maincpu_mainloop();
-      retro_renderloop = 1;
+      int64_t frame_start = (frame_max > 1) ? warp_time_usec() : 0;
+      CLOCK frame_clk     = maincpu_clk;
 
-      if (perf_cb.get_time_usec && frame_max > 1)
-         frame_max = 1000000 / (retro_refresh / 5) / (retro_ticks() - frame_time);
+      retro_run_frame();
 
-      if (frame_max > 1 && (!retro_warp_mode_enabled() || is_audio_playing_while_autoloadwarping()))
-         frame_max = 1;
+      if (frame_max > 1 && !warp_next_frame(warp_start, frame_start, frame_clk))
+         break;
    }
+   retro_skip_video = false;
+
+   /* Run-ahead, emulate the frames ahead for output and return to the real frame */
+   if (runahead)
+      runahead_run(opt_runahead);
+
+   /* In-core rewind history */
+   if (opt_rewind_size && !retro_rewinding && retro_ui_finalized)
+      rewind_push();
 
    /* LED interface */
    if (led_state_cb)
@@ -7979,7 +8253,10 @@ void retro_run(void)
 
    /* Virtual keyboard */
    if (retro_vkbd)
+   {
       print_vkbd();
+      retro_frame_dirty = retro_frame_force_dirty = true;
+   }
 
    /* Statusbar message timer */
    if (statusbar_message_timer > 0)
@@ -7987,7 +8264,10 @@ void retro_run(void)
 
    /* Forced statusbar messages */
    if ((!retro_statusbar && opt_statusbar & STATUSBAR_MESSAGES && statusbar_message_timer) || retro_statusbar)
+   {
       uistatusbar_draw();
+      retro_frame_dirty = retro_frame_force_dirty = true;
+   }
 
    /* Set volume back to maximum after starting with mute, due to ReSID 6581 init pop */
    if (sound_volume_counter > 0)
@@ -7997,11 +8277,24 @@ void retro_run(void)
          resources_set_int("SoundVolume", 100);
    }
 
-   /* Video output */
-   video_cb(retro_bmp + retro_bmp_offset, zoomed_width, zoomed_height, retrow << (pix_bytes >> 1));
+   /* Video output, audio went out directly from the sound buffer on vsync.
+    * Unchanged frames are duped when the frontend allows */
+   if (  retro_bmp_offset != video_prev_offset
+      || zoomed_width != video_prev_width
+      || zoomed_height != video_prev_height
+      || retrow != video_prev_pitch)
+   {
+      video_prev_offset = retro_bmp_offset;
+      video_prev_width  = zoomed_width;
+      video_prev_height = zoomed_height;
+      video_prev_pitch  = retrow;
+      retro_frame_dirty = true;
+   }
 
-   /* Audio output */
-   upload_output_audio_buffer();
+   if (retro_frame_dirty || !libretro_can_dupe)
+      video_cb(retro_bmp + retro_bmp_offset, zoomed_width, zoomed_height, retrow << (pix_bytes >> 1));
+   else
+      video_cb(NULL, zoomed_width, zoomed_height, retrow << (pix_bytes >> 1));
 
    /* Update geometry if model or zoom mode changes */
    if ((lastw == retrow && lasth == retroh) && zoom_mode_id != zoom_mode_id_prev)
@@ -8016,6 +8309,8 @@ void retro_run(void)
       request_restart = false;
       emu_reset(0);
    }
+
+   retro_run_active = false;
 }
 
 bool retro_load_game(const struct retro_game_info *info)
@@ -8058,6 +8353,9 @@ bool retro_load_game(const struct retro_game_info *info)
       runstate = RUNSTATE_LOADED_CONTENT;
    }
 
+   /* Rewind history belongs to the previous content */
+   rewind_reset();
+
    struct retro_memory_descriptor memdesc[] = {
       {RETRO_MEMDESC_SYSTEM_RAM, mem_ram, 0, 0, 0, 0, mem_ram_size, NULL}
    };
@@ -8139,6 +8437,8 @@ static void dc_sync_index(void)
 
 /* CPU traps ensure we are never saving snapshots or loading them in the middle of a cpu instruction.
    Without this, savestate corruption occurs.
+   After a frame the CPU already is on an instruction boundary, so the trap round trip
+   and the extra emulation it causes are skipped, keeping snapshots on the frame edge.
 */
 
 static void save_trap(uint16_t addr, void *success)
@@ -8157,6 +8457,7 @@ static void save_trap(uint16_t addr, void *success)
    else
       *((int *)success) = 0;
    save_trap_happened = 1;
+   maincpu_loop_exit_pending = 1;
 }
 
 static void load_trap(uint16_t addr, void *success)
@@ -8167,6 +8468,44 @@ static void load_trap(uint16_t addr, void *success)
    else
       *((int *)success) = 0;
    load_trap_happened = 1;
+   maincpu_loop_exit_pending = 1;
+}
+
+static int retro_snapshot_save(void)
+{
+   int success = 0;
+   if (retro_frame_edge)
+   {
+      save_trap(0, (void *)&success);
+      maincpu_loop_exit_pending = 0;
+   }
+   else
+   {
+      interrupt_maincpu_trigger_trap(save_trap, (void *)&success);
+      save_trap_happened = 0;
+      while (!save_trap_happened)
+         maincpu_mainloop();
+   }
+   return success;
+}
+
+static int retro_snapshot_load(void)
+{
+   int success = 0;
+   if (retro_frame_edge)
+   {
+      /* CPU loop picks up the new registers when it is entered again */
+      load_trap(0, (void *)&success);
+      maincpu_loop_exit_pending = 0;
+   }
+   else
+   {
+      interrupt_maincpu_trigger_trap(load_trap, (void *)&success);
+      load_trap_happened = 0;
+      while (!load_trap_happened)
+         maincpu_mainloop();
+   }
+   return success;
 }
 
 static void retro_unserialize_post(void)
@@ -8187,18 +8526,22 @@ size_t retro_serialize_size(void)
    long snapshot_size = 0;
    if (retro_ui_finalized)
    {
+      /* Size is measured once and then kept up to date by retro_serialize(),
+       * configuration changes invalidate it via snapshot_size_invalidate().
+       * The cached size carries SNAPSHOT_SIZE_HEADROOM for states that grow
+       * before the next write */
+      snapshot_size = snapshot_size_get();
+      if (snapshot_size)
+         return snapshot_size;
+
       snapshot_stream = snapshot_memory_write_fopen(NULL, 0);
-      int success = 0;
-      interrupt_maincpu_trigger_trap(save_trap, (void *)&success);
-      save_trap_happened = 0;
-      while (!save_trap_happened)
-         maincpu_mainloop();
+      int success = retro_snapshot_save();
       if (snapshot_stream != NULL)
       {
          if (success)
          {
-            snapshot_fseek(snapshot_stream, 0, SEEK_END);
-            snapshot_size = snapshot_ftell(snapshot_stream);
+            snapshot_size_update();
+            snapshot_size = snapshot_size_get();
          }
          else
          {
@@ -8230,11 +8573,7 @@ bool retro_serialize(void *data_, size_t size)
    if (retro_ui_finalized)
    {
       snapshot_stream = snapshot_memory_write_fopen(data_, size);
-      int success = 0;
-      interrupt_maincpu_trigger_trap(save_trap, (void *)&success);
-      save_trap_happened = 0;
-      while (!save_trap_happened)
-         maincpu_mainloop();
+      int success = retro_snapshot_save();
       if (snapshot_stream != NULL)
       {
          snapshot_fclose(snapshot_stream);
@@ -8242,38 +8581,145 @@ bool retro_serialize(void *data_, size_t size)
       }
       if (success)
       {
+         snapshot_size_update();
          return true;
       }
+      /* Buffer was probably too small, measure again on next size query */
+      snapshot_size_invalidate();
       log_cb(RETRO_LOG_INFO, "Failed to serialize snapshot\n");
    }
    return false;
 }
 
-bool retro_unserialize(const void *data_, size_t size)
+/* Plain state restore without the frontend side effects, for in-core rewind */
+bool retro_unserialize_state(const void *data_, size_t size)
 {
    if (retro_ui_finalized)
    {
       snapshot_stream = snapshot_memory_read_fopen(data_, size);
-      int success = 0;
-      interrupt_maincpu_trigger_trap(load_trap, (void *)&success);
-      load_trap_happened = 0;
-      while (!load_trap_happened)
-         maincpu_mainloop();
+      /* A state of the reported size has the current layout */
+      snapshot_size_hold(size == snapshot_size_get());
+      int success = retro_snapshot_load();
+      snapshot_size_hold(0);
       if (snapshot_stream != NULL)
       {
          snapshot_fclose(snapshot_stream);
          snapshot_stream = NULL;
       }
       if (success)
-      {
-         retro_unserialize_post();
          return true;
-      }
+      snapshot_size_invalidate();
       log_cb(RETRO_LOG_INFO, "Failed to unserialize snapshot\n");
    }
    return false;
 }
 
+bool retro_unserialize(const void *data_, size_t size)
+{
+   if (retro_unserialize_state(data_, size))
+   {
+      retro_unserialize_post();
+      /* History before the loaded state does not lead to it */
+      rewind_reset();
+      return true;
+   }
+   return false;
+}
+
+/* Run-ahead keeps a checkpoint of the real frame in a core owned buffer.
+ * Only the volatile machine state goes in, and it is restored without the
+ * side effects of retro_unserialize() */
+static uint8_t *runahead_state = NULL;
+static size_t runahead_state_size = 0;
+static size_t runahead_checkpoint_size = 0;
+
+static void runahead_free(void)
+{
+   free(runahead_state);
+   runahead_state = NULL;
+   runahead_state_size = 0;
+}
+
+static bool runahead_allowed(void)
+{
+   size_t size;
+   uint8_t *tmp;
+
+   /* Autostart and keyboard buffer progress is not part of the snapshot,
+    * and neither are disks, so frames ahead must not write to them */
+   if (  !opt_runahead
+      || !retro_ui_finalized
+      || retro_warp_mode_enabled()
+      || autostart_in_progress()
+      || !kbdbuf_is_empty()
+      || drive_write_pending())
+      return false;
+
+   size = retro_serialize_size();
+   if (!size)
+      return false;
+   if (size > runahead_state_size)
+   {
+      tmp = (uint8_t *)realloc(runahead_state, size);
+      if (!tmp)
+         return false;
+      runahead_state      = tmp;
+      runahead_state_size = size;
+   }
+   return true;
+}
+
+static void runahead_run(unsigned int frames)
+{
+   unsigned int i;
+   int success;
+
+   snapshot_stream = snapshot_memory_write_fopen(runahead_state, runahead_state_size);
+   if (!snapshot_stream)
+      return;
+   success = machine_write_checkpoint_to_stream(snapshot_stream) >= 0;
+   /* Reading must stop at the end, modules that are not found are
+    * searched for up to the end of the stream */
+   runahead_checkpoint_size = (size_t)snapshot_ftell(snapshot_stream);
+   snapshot_fclose(snapshot_stream);
+   snapshot_stream = NULL;
+   if (!success)
+      return;
+   sound_runahead_save();
+
+   /* Only the last frame ahead is shown, audio belongs to the real frame */
+   retro_skip_audio = true;
+   for (i = 0; i < frames; i++)
+   {
+      retro_skip_video = (i < frames - 1);
+      retro_run_frame();
+   }
+   retro_skip_video = false;
+   retro_skip_audio = false;
+
+   snapshot_stream = snapshot_memory_read_fopen(runahead_state, runahead_checkpoint_size);
+   success = 0;
+   if (snapshot_stream)
+   {
+      snapshot_size_hold(1);
+      success = machine_read_checkpoint_from_stream(snapshot_stream) >= 0;
+      snapshot_size_hold(0);
+      snapshot_fclose(snapshot_stream);
+      snapshot_stream = NULL;
+   }
+   if (success)
+   {
+      sound_runahead_restore();
+      return;
+   }
+
+   /* The machine is left in the future or half restored, start over */
+   log_cb(RETRO_LOG_ERROR, "Failed to restore run-ahead checkpoint, disabling Run-Ahead\n");
+   opt_runahead    = 0;
+   runahead_free();
+   request_restart = true;
+}
+
 void *retro_get_memory_data(unsigned id)
 {
    if (id == RETRO_MEMORY_SYSTEM_RAM)
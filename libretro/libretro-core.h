@@ -43,6 +43,9 @@ typedef uint8_t uint8;
 #ifndef MIN
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
 
 /* Screen */
 #if defined(__X128__)
@@ -129,6 +132,9 @@ extern unsigned short int pix_bytes;
 
 /* Variables */
 extern unsigned int retro_renderloop;
+extern bool retro_skip_video;
+extern bool retro_frame_dirty;
+extern bool retro_frame_force_dirty;
 extern unsigned int retroXS;
 extern unsigned int retroYS;
 extern unsigned int retroXS_offset;
@@ -148,6 +154,7 @@ extern int request_model_set;
 extern unsigned int retro_warpmode;
 extern int retro_warp_mode_enabled(void);
 extern bool audio_playing(void);
+extern bool retro_unserialize_state(const void *data_, size_t size);
 extern unsigned int zoom_mode_id;
 extern int zoom_mode_id_prev;
 
@@ -235,6 +242,7 @@ enum EMU_FUNCTIONS
    EMU_ZOOM_MODE,
    EMU_TURBO_FIRE,
    EMU_WARP_MODE,
+   EMU_REWIND,
    EMU_DATASETTE_HOTKEYS,
    EMU_DATASETTE_STOP,
    EMU_DATASETTE_START,
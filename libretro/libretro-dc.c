@@ -18,6 +18,8 @@
 
 #include "libretro-dc.h"
 #include "libretro-core.h"
+#include "libretro-memvfs.h"
+#include "libretro-metacache.h"
 
 #include "archdep.h"
 #include "attach.h"
@@ -98,6 +100,32 @@ static bool is_ugly(const char* label)
 #define PETSCII_SHIFTED_A   0x60
 #define PETSCII_SHIFTED_Z   0x7A
 
+/* Read the raw image name of `len' bytes at `pos', from the metadata
+ * cache while the file is unchanged since it was last read */
+static bool read_label(const char* filename, long pos, size_t len, unsigned char* label)
+{
+   size_t size = len;
+   bool ok = false;
+   FILE* fd;
+
+   if (metacache_get(filename, METACACHE_LABEL, 0, label, &size) && size == len)
+      ok = true;
+   else if ((fd = fopen(filename, "rb")) != NULL)
+   {
+      if (fseek(fd, pos, SEEK_SET) == 0
+         && fread(label, len, 1, fd) == 1)
+      {
+         metacache_set(filename, METACACHE_LABEL, 0, label, len);
+         ok = true;
+      }
+      fclose(fd);
+   }
+
+   if (ok)
+      label[len] = '\0';
+   return ok;
+}
+
 /* Try to read disk or tape name from image
  * Allocates returned string */
 static char* get_label(const char* filename)
@@ -115,36 +143,18 @@ static char* get_label(const char* filename)
    /* Disk image which we can read name from */
    if (strendswith(filename, "d64") || strendswith(filename, "d71"))
    {
-      FILE* fd = fopen(filename, "rb");
-
-      if (fd != NULL)
-      {
-         if (fseek(fd, D64_NAME_POS, SEEK_SET) == 0
-            && fread(label, D64_FULL_NAME_LEN, 1, fd) == 1)
-         {
-            label[D64_FULL_NAME_LEN] = '\0';
-            have_disk_label = true;
-         }
-         fclose(fd);
-      }
+      if (read_label(filename, D64_NAME_POS, D64_FULL_NAME_LEN, label))
+         have_disk_label = true;
    }
 
    /* Tape image which we can read name from */
    if (strendswith(filename, "t64"))
    {
-      FILE* fd = fopen(filename, "rb");
-
-      if (fd != NULL)
+      if (read_label(filename, T64_NAME_POS, T64_NAME_LEN, label))
       {
-         if (fseek(fd, T64_NAME_POS, SEEK_SET) == 0
-            && fread(label, T64_NAME_LEN, 1, fd) == 1)
-         {
-            label[T64_NAME_LEN] = '\0';
 #if 0
-            have_tape_label = true;
+         have_tape_label = true;
 #endif
-         }
-         fclose(fd);
       }
    }
 
@@ -461,21 +471,21 @@ bool dc_replace_file(dc_storage* dc, int index, const char* filename)
          snprintf(zip_m3u_list.path, sizeof(zip_m3u_list.path), "%s%s%s.m3u",
                retro_temp_directory, FSDEV_DIR_SEP_STR, utf8_to_local_string_alloc(zip_basename));
 
-         DIR *zip_dir;
-         struct dirent *zip_dirp;
+         memvfs_dir_t *zip_dir;
+         char *zip_name;
 
          /* Convert all NIBs to G64 */
-         zip_dir = opendir(retro_temp_directory);
-         while ((zip_dirp = readdir(zip_dir)) != NULL)
+         zip_dir = memvfs_opendir(retro_temp_directory);
+         while ((zip_name = memvfs_readdir(zip_dir)) != NULL)
          {
-            if (dc_get_image_type(zip_dirp->d_name) == DC_IMAGE_TYPE_NIBBLER)
+            if (dc_get_image_type(zip_name) == DC_IMAGE_TYPE_NIBBLER)
             {
-               snprintf(nib_input, sizeof(nib_input), "%s%s%s", retro_temp_directory, FSDEV_DIR_SEP_STR, zip_dirp->d_name);
-               snprintf(nib_output, sizeof(nib_output), "%s%s%s.g64", retro_temp_directory, FSDEV_DIR_SEP_STR, path_remove_extension(zip_dirp->d_name));
+               snprintf(nib_input, sizeof(nib_input), "%s%s%s", retro_temp_directory, FSDEV_DIR_SEP_STR, zip_name);
+               snprintf(nib_output, sizeof(nib_output), "%s%s%s.g64", retro_temp_directory, FSDEV_DIR_SEP_STR, path_remove_extension(zip_name));
                nib_convert(nib_input, nib_output);
             }
          }
-         closedir(zip_dir);
+         memvfs_closedir(zip_dir);
 
          m3u_scan_recurse(retro_temp_directory, &zip_m3u_list);
 
@@ -978,21 +988,21 @@ void dc_parse_list(dc_storage* dc, const char* list_file, bool is_vfl, const cha
             }
             else
             {
-               DIR *zip_dir = NULL;
-               struct dirent *zip_dirp;
+               memvfs_dir_t *zip_dir = NULL;
+               char *zip_name;
 
-               zip_dir = opendir(retro_temp_directory);
-               while ((zip_dirp = readdir(zip_dir)) != NULL)
+               zip_dir = memvfs_opendir(retro_temp_directory);
+               while ((zip_name = memvfs_readdir(zip_dir)) != NULL)
                {
-                  if (dc_get_image_type(zip_dirp->d_name) == DC_IMAGE_TYPE_NIBBLER)
+                  if (dc_get_image_type(zip_name) == DC_IMAGE_TYPE_NIBBLER)
                   {
-                     snprintf(nib_input, sizeof(nib_input), "%s%s%s", retro_temp_directory, FSDEV_DIR_SEP_STR, zip_dirp->d_name);
-                     snprintf(nib_output, sizeof(nib_output), "%s%s%s.g64", retro_temp_directory, FSDEV_DIR_SEP_STR, path_remove_extension(zip_dirp->d_name));
+                     snprintf(nib_input, sizeof(nib_input), "%s%s%s", retro_temp_directory, FSDEV_DIR_SEP_STR, zip_name);
+                     snprintf(nib_output, sizeof(nib_output), "%s%s%s.g64", retro_temp_directory, FSDEV_DIR_SEP_STR, path_remove_extension(zip_name));
                      nib_convert(nib_input, nib_output);
                      snprintf(lastfile, sizeof(lastfile), "%s", path_basename(nib_output));
                   }
                }
-               closedir(zip_dir);
+               memvfs_closedir(zip_dir);
             }
 
             snprintf(file_path, RETRO_PATH_MAX, "%s%s%s", retro_temp_directory, FSDEV_DIR_SEP_STR, lastfile);
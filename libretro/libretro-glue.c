@@ -1,4 +1,5 @@
 #include "libretro-core.h"
+#include "libretro-memvfs.h"
 #include "encodings/utf.h"
 #include "streams/file_stream.h"
 
@@ -35,27 +36,27 @@ int qstrcmp(const void *a, const void *b)
 
 void remove_recurse(const char *path)
 {
-   struct dirent *dirp;
+   char *name;
    char filename[RETRO_PATH_MAX];
-   DIR *dir = opendir(path);
+   memvfs_dir_t *dir = memvfs_opendir(path);
    if (dir == NULL)
       return;
 
-   while ((dirp = readdir(dir)) != NULL)
+   while ((name = memvfs_readdir(dir)) != NULL)
    {
-      if (dirp->d_name[0] == '.')
+      if (name[0] == '.')
          continue;
 
-      sprintf(filename, "%s%s%s", path, FSDEV_DIR_SEP_STR, dirp->d_name);
+      sprintf(filename, "%s%s%s", path, FSDEV_DIR_SEP_STR, name);
       log_cb(RETRO_LOG_INFO, "Clean: %s\n", filename);
 
       if (path_is_directory(filename))
          remove_recurse(filename);
       else
-         remove(filename);
+         memvfs_remove(filename);
    }
 
-   closedir(dir);
+   memvfs_closedir(dir);
 
    /* Leave the root directory for RAM disk usage */
    if (strcmp(retro_temp_directory, path))
@@ -64,36 +65,36 @@ void remove_recurse(const char *path)
 
 void m3u_scan_recurse(const char *path, zip_m3u_t *list)
 {
-   DIR *zip_dir;
-   struct dirent *zip_dirp;
+   memvfs_dir_t *zip_dir;
+   char *zip_name;
    char *zip_lastfile = {0};
 
-   zip_dir = opendir(path);
+   zip_dir = memvfs_opendir(path);
 
-   while ((zip_dirp = readdir(zip_dir)) != NULL)
+   while ((zip_name = memvfs_readdir(zip_dir)) != NULL)
    {
       char zip_fullpath[RETRO_PATH_MAX] = {0};
 
-      if (zip_dirp->d_name[0] == '.' || strendswith(zip_dirp->d_name, ".m3u") || list->mode > 1)
+      if (zip_name[0] == '.' || strendswith(zip_name, ".m3u") || list->mode > 1)
          continue;
 
-      path_join(zip_fullpath, retro_temp_directory, zip_dirp->d_name);
+      path_join(zip_fullpath, retro_temp_directory, zip_name);
       if (path_is_directory(zip_fullpath))
       {
          m3u_scan_recurse(zip_fullpath, list);
          continue;
       }
 
-      path_join(zip_fullpath, path, zip_dirp->d_name);
+      path_join(zip_fullpath, path, zip_name);
       if (!strcmp(path, retro_temp_directory))
-         zip_lastfile = local_to_utf8_string_alloc(zip_dirp->d_name);
+         zip_lastfile = local_to_utf8_string_alloc(zip_name);
       else
          zip_lastfile = local_to_utf8_string_alloc(zip_fullpath);
 
       /* Multi file mode, generate playlist */
-      if (dc_get_image_type(zip_dirp->d_name) == DC_IMAGE_TYPE_FLOPPY
-       || dc_get_image_type(zip_dirp->d_name) == DC_IMAGE_TYPE_TAPE
-       || dc_get_image_type(zip_dirp->d_name) == DC_IMAGE_TYPE_MEM
+      if (dc_get_image_type(zip_name) == DC_IMAGE_TYPE_FLOPPY
+       || dc_get_image_type(zip_name) == DC_IMAGE_TYPE_TAPE
+       || dc_get_image_type(zip_name) == DC_IMAGE_TYPE_MEM
       )
       {
          list->mode = 1;
@@ -101,7 +102,7 @@ void m3u_scan_recurse(const char *path, zip_m3u_t *list)
          snprintf(list->list[list->num-1], RETRO_PATH_MAX, "%s", zip_lastfile);
       }
    }
-   closedir(zip_dir);
+   memvfs_closedir(zip_dir);
 
    if (zip_lastfile)
       free(zip_lastfile);
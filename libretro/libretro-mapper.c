@@ -3,6 +3,7 @@
 #include "libretro-mapper.h"
 #include "libretro-vkbd.h"
 #include "libretro-graph.h"
+#include "libretro-rewind.h"
 
 #include "archdep.h"
 #include "joystick.h"
@@ -142,6 +143,9 @@ int retro_ui_get_pointer_state(int *px, int *py, unsigned int *pbuttons)
 
       draw_vline(*px, *py + 1, 1, 3, pointer_color);
       draw_vline(*px, *py + 2, 1, 1, pointer_white);
+
+      /* Pointer is drawn over the frame */
+      retro_frame_dirty = retro_frame_force_dirty = true;
    }
 
    return 1;
@@ -293,6 +297,9 @@ void emu_function(int function)
          retro_warpmode = (retro_warpmode) ? 0 : 1;
          resources_set_int("WarpMode", retro_warpmode);
          break;
+      case EMU_REWIND:
+         retro_rewinding = !retro_rewinding;
+         break;
       case EMU_DATASETTE_HOTKEYS:
 #if defined(__X64DTV__) || defined(__XSCPU64__)
          break;
@@ -500,6 +507,9 @@ void update_input(unsigned disable_keys)
             case RETRO_MAPPER_WARP_MODE:
                emu_function(EMU_WARP_MODE);
                break;
+            case RETRO_MAPPER_REWIND:
+               emu_function(EMU_REWIND);
+               break;
             case RETRO_MAPPER_TURBO_FIRE:
                emu_function(EMU_TURBO_FIRE);
                break;
@@ -554,6 +564,9 @@ void update_input(unsigned disable_keys)
             case RETRO_MAPPER_WARP_MODE:
                emu_function(EMU_WARP_MODE);
                break;
+            case RETRO_MAPPER_REWIND:
+               emu_function(EMU_REWIND);
+               break;
          }
       }
       else if (mapper_keys_pressed_time)
@@ -696,6 +709,8 @@ void update_input(unsigned disable_keys)
                   emu_function(EMU_ZOOM_MODE);
                else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_WARP_MODE])
                   emu_function(EMU_WARP_MODE);
+               else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_REWIND])
+                  emu_function(EMU_REWIND);
                else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_TURBO_FIRE])
                   emu_function(EMU_TURBO_FIRE);
                else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_SAVE_DISK])
@@ -769,6 +784,8 @@ void update_input(unsigned disable_keys)
                   ; /* nop */
                else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_WARP_MODE])
                   emu_function(EMU_WARP_MODE);
+               else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_REWIND])
+                  emu_function(EMU_REWIND);
                else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_TURBO_FIRE])
                   ; /* nop */
                else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_SAVE_DISK])
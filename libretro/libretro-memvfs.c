@@ -0,0 +1,710 @@
+#include "libretro.h"
+#include "libretro-core.h"
+#include "libretro-memvfs.h"
+
+#include "archdep.h"
+
+#include "streams/file_stream.h"
+#include "vfs/vfs_implementation.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern retro_log_printf_t log_cb;
+
+typedef struct memvfs_file
+{
+   char *path;
+   uint8_t *data;
+   size_t size;
+   size_t alloc;
+   bool is_dir;
+   bool unlinked;
+   unsigned refs;
+   struct memvfs_file *next;
+} memvfs_file_t;
+
+/* Every handle given to file_stream is wrapped, either around a host
+ * handle or around a memory file */
+typedef struct memvfs_handle
+{
+   struct retro_vfs_file_handle *host;
+   memvfs_file_t *file;
+   unsigned mode;
+   int64_t pos;
+} memvfs_handle_t;
+
+struct memvfs_dir
+{
+   char **names;
+   unsigned count;
+   unsigned alloc;
+   unsigned index;
+};
+
+static const char *memvfs_root                  = NULL;
+static bool memvfs_exported                     = false;
+static memvfs_file_t *memvfs_files              = NULL;
+
+static const struct retro_vfs_interface *host   = NULL;
+static unsigned host_version                    = 0;
+
+/* Paths */
+static bool memvfs_is_sep(char c)
+{
+   return c == '/' || c == '\\';
+}
+
+/* Length of the common part of `path' and `prefix' if `prefix' is a
+ * directory prefix of `path', separators compare equal */
+static size_t memvfs_prefix(const char *path, const char *prefix)
+{
+   size_t i;
+   for (i = 0; prefix[i]; i++)
+   {
+      if (path[i] == prefix[i])
+         continue;
+      if (memvfs_is_sep(path[i]) && memvfs_is_sep(prefix[i]))
+         continue;
+      return 0;
+   }
+   if (i && memvfs_is_sep(prefix[i - 1]))
+      return i;
+   if (path[i] && !memvfs_is_sep(path[i]))
+      return 0;
+   return i;
+}
+
+static bool memvfs_path_equal(const char *a, const char *b)
+{
+   size_t len = memvfs_prefix(a, b);
+   return (len || !*b) && !a[len];
+}
+
+static bool memvfs_in_root(const char *path)
+{
+   if (!path || !memvfs_root || !*memvfs_root || memvfs_exported)
+      return false;
+   return memvfs_prefix(path, memvfs_root) != 0;
+}
+
+static memvfs_file_t *memvfs_find(const char *path)
+{
+   memvfs_file_t *file;
+   for (file = memvfs_files; file; file = file->next)
+      if (memvfs_path_equal(file->path, path))
+         return file;
+   return NULL;
+}
+
+/* Directory either created explicitly or implied by a file below it */
+static bool memvfs_is_directory(const char *path)
+{
+   memvfs_file_t *file;
+   size_t len;
+
+   if (memvfs_path_equal(path, memvfs_root))
+      return true;
+
+   for (file = memvfs_files; file; file = file->next)
+   {
+      len = memvfs_prefix(file->path, path);
+      if (len && (file->path[len] || file->is_dir))
+         return true;
+   }
+   return false;
+}
+
+static memvfs_file_t *memvfs_create(const char *path, bool is_dir)
+{
+   memvfs_file_t *file = (memvfs_file_t*)calloc(1, sizeof(memvfs_file_t));
+   if (!file)
+      return NULL;
+
+   file->path   = strdup(path);
+   file->is_dir = is_dir;
+   if (!file->path)
+   {
+      free(file);
+      return NULL;
+   }
+
+   file->next   = memvfs_files;
+   memvfs_files = file;
+   return file;
+}
+
+static void memvfs_release(memvfs_file_t *file)
+{
+   if (file->refs || !file->unlinked)
+      return;
+   free(file->path);
+   free(file->data);
+   free(file);
+}
+
+static void memvfs_unlink(memvfs_file_t *file)
+{
+   memvfs_file_t **link;
+   for (link = &memvfs_files; *link; link = &(*link)->next)
+   {
+      if (*link == file)
+      {
+         *link          = file->next;
+         file->unlinked = true;
+         memvfs_release(file);
+         return;
+      }
+   }
+}
+
+static bool memvfs_reserve(memvfs_file_t *file, size_t size)
+{
+   uint8_t *tmp;
+   size_t alloc;
+
+   if (file->alloc >= size)
+      return true;
+
+   alloc = file->alloc ? file->alloc : 4096;
+   while (alloc < size)
+      alloc *= 2;
+
+   tmp = (uint8_t*)realloc(file->data, alloc);
+   if (!tmp)
+      return false;
+
+   file->data  = tmp;
+   file->alloc = alloc;
+   return true;
+}
+
+/* Host VFS, the frontend interface or the bundled implementation */
+static struct retro_vfs_file_handle *host_open(const char *path, unsigned mode, unsigned hints)
+{
+   if (host)
+      return host->open(path, mode, hints);
+   return (struct retro_vfs_file_handle*)retro_vfs_file_open_impl(path, mode, hints);
+}
+
+static int host_close(struct retro_vfs_file_handle *stream)
+{
+   if (host)
+      return host->close(stream);
+   return retro_vfs_file_close_impl((libretro_vfs_implementation_file*)stream);
+}
+
+static int64_t host_write(struct retro_vfs_file_handle *stream, const void *s, uint64_t len)
+{
+   if (host)
+      return host->write(stream, s, len);
+   return retro_vfs_file_write_impl((libretro_vfs_implementation_file*)stream, s, len);
+}
+
+static int host_stat(const char *path, int32_t *size)
+{
+   if (host && host_version >= 3)
+      return host->stat(path, size);
+   return retro_vfs_stat_impl(path, size);
+}
+
+static int host_mkdir(const char *dir)
+{
+   if (host && host_version >= 3)
+      return host->mkdir(dir);
+   return retro_vfs_mkdir_impl(dir);
+}
+
+static int host_remove(const char *path)
+{
+   if (host)
+      return host->remove(path);
+   return retro_vfs_file_remove_impl(path);
+}
+
+/* VFS interface */
+static const char *RETRO_CALLCONV memvfs_get_path(struct retro_vfs_file_handle *stream)
+{
+   memvfs_handle_t *handle = (memvfs_handle_t*)stream;
+
+   if (handle->file)
+      return handle->file->path;
+   if (host)
+      return host->get_path(handle->host);
+   return retro_vfs_file_get_path_impl((libretro_vfs_implementation_file*)handle->host);
+}
+
+static struct retro_vfs_file_handle *RETRO_CALLCONV memvfs_open(const char *path, unsigned mode, unsigned hints)
+{
+   memvfs_handle_t *handle = NULL;
+   memvfs_file_t *file     = NULL;
+
+   if (!path)
+      return NULL;
+
+   if (memvfs_in_root(path))
+   {
+      file = memvfs_find(path);
+      if ((file && file->is_dir) || memvfs_is_directory(path))
+         return NULL;
+
+      if (mode & RETRO_VFS_FILE_ACCESS_WRITE)
+      {
+         if (!file)
+         {
+            /* Files left on the storage are still updated in place */
+            if ((mode & RETRO_VFS_FILE_ACCESS_UPDATE_EXISTING) && (host_stat(path, NULL) & RETRO_VFS_STAT_IS_VALID))
+               goto host_file;
+            file = memvfs_create(path, false);
+            if (!file)
+               return NULL;
+         }
+         else if (!(mode & RETRO_VFS_FILE_ACCESS_UPDATE_EXISTING))
+            file->size = 0;
+      }
+   }
+
+   if (file)
+   {
+      handle = (memvfs_handle_t*)calloc(1, sizeof(memvfs_handle_t));
+      if (!handle)
+         return NULL;
+      handle->file = file;
+      handle->mode = mode;
+      file->refs++;
+      return (struct retro_vfs_file_handle*)handle;
+   }
+
+host_file:
+   handle = (memvfs_handle_t*)calloc(1, sizeof(memvfs_handle_t));
+   if (!handle)
+      return NULL;
+   handle->host = host_open(path, mode, hints);
+   if (!handle->host)
+   {
+      free(handle);
+      return NULL;
+   }
+   return (struct retro_vfs_file_handle*)handle;
+}
+
+static int RETRO_CALLCONV memvfs_close(struct retro_vfs_file_handle *stream)
+{
+   memvfs_handle_t *handle = (memvfs_handle_t*)stream;
+   int ret                 = 0;
+
+   if (handle->file)
+   {
+      handle->file->refs--;
+      memvfs_release(handle->file);
+   }
+   else
+      ret = host_close(handle->host);
+
+   free(handle);
+   return ret;
+}
+
+static int64_t RETRO_CALLCONV memvfs_size(struct retro_vfs_file_handle *stream)
+{
+   memvfs_handle_t *handle = (memvfs_handle_t*)stream;
+
+   if (handle->file)
+      return (int64_t)handle->file->size;
+   if (host)
+      return host->size(handle->host);
+   return retro_vfs_file_size_impl((libretro_vfs_implementation_file*)handle->host);
+}
+
+static int64_t RETRO_CALLCONV memvfs_truncate(struct retro_vfs_file_handle *stream, int64_t length)
+{
+   memvfs_handle_t *handle = (memvfs_handle_t*)stream;
+
+   if (handle->file)
+   {
+      if (length < 0 || !(handle->mode & RETRO_VFS_FILE_ACCESS_WRITE))
+         return -1;
+      if ((size_t)length > handle->file->size)
+      {
+         if (!memvfs_reserve(handle->file, (size_t)length))
+            return -1;
+         memset(handle->file->data + handle->file->size, 0, (size_t)length - handle->file->size);
+      }
+      handle->file->size = (size_t)length;
+      return 0;
+   }
+   if (host)
+      return (host_version >= 2) ? host->truncate(handle->host, length) : -1;
+   return retro_vfs_file_truncate_impl((libretro_vfs_implementation_file*)handle->host, length);
+}
+
+static int64_t RETRO_CALLCONV memvfs_tell(struct retro_vfs_file_handle *stream)
+{
+   memvfs_handle_t *handle = (memvfs_handle_t*)stream;
+
+   if (handle->file)
+      return handle->pos;
+   if (host)
+      return host->tell(handle->host);
+   return retro_vfs_file_tell_impl((libretro_vfs_implementation_file*)handle->host);
+}
+
+static int64_t RETRO_CALLCONV memvfs_seek(struct retro_vfs_file_handle *stream, int64_t offset, int seek_position)
+{
+   memvfs_handle_t *handle = (memvfs_handle_t*)stream;
+   int64_t pos;
+
+   if (!handle->file)
+   {
+      if (host)
+         return host->seek(handle->host, offset, seek_position);
+      return retro_vfs_file_seek_impl((libretro_vfs_implementation_file*)handle->host, offset, seek_position);
+   }
+
+   switch (seek_position)
+   {
+      case RETRO_VFS_SEEK_POSITION_START:
+         pos = offset;
+         break;
+      case RETRO_VFS_SEEK_POSITION_CURRENT:
+         pos = handle->pos + offset;
+         break;
+      case RETRO_VFS_SEEK_POSITION_END:
+         pos = (int64_t)handle->file->size + offset;
+         break;
+      default:
+         return -1;
+   }
+   if (pos < 0)
+      return -1;
+
+   /* Same result as the stdio backed implementation */
+   handle->pos = pos;
+   return 0;
+}
+
+static int64_t RETRO_CALLCONV memvfs_read(struct retro_vfs_file_handle *stream, void *s, uint64_t len)
+{
+   memvfs_handle_t *handle = (memvfs_handle_t*)stream;
+   memvfs_file_t *file     = handle->file;
+
+   if (!file)
+   {
+      if (host)
+         return host->read(handle->host, s, len);
+      return retro_vfs_file_read_impl((libretro_vfs_implementation_file*)handle->host, s, len);
+   }
+
+   if (!(handle->mode & RETRO_VFS_FILE_ACCESS_READ))
+      return -1;
+   if ((uint64_t)handle->pos >= file->size)
+      return 0;
+   if (len > file->size - (uint64_t)handle->pos)
+      len = file->size - (uint64_t)handle->pos;
+
+   memcpy(s, file->data + handle->pos, (size_t)len);
+   handle->pos += (int64_t)len;
+   return (int64_t)len;
+}
+
+static int64_t RETRO_CALLCONV memvfs_write(struct retro_vfs_file_handle *stream, const void *s, uint64_t len)
+{
+   memvfs_handle_t *handle = (memvfs_handle_t*)stream;
+   memvfs_file_t *file     = handle->file;
+   size_t end;
+
+   if (!file)
+      return host_write(handle->host, s, len);
+
+   if (!(handle->mode & RETRO_VFS_FILE_ACCESS_WRITE))
+      return -1;
+
+   end = (size_t)handle->pos + (size_t)len;
+   if (!memvfs_reserve(file, end))
+      return -1;
+   if ((size_t)handle->pos > file->size)
+      memset(file->data + file->size, 0, (size_t)handle->pos - file->size);
+
+   memcpy(file->data + handle->pos, s, (size_t)len);
+   handle->pos = (int64_t)end;
+   if (end > file->size)
+      file->size = end;
+   return (int64_t)len;
+}
+
+static int RETRO_CALLCONV memvfs_flush(struct retro_vfs_file_handle *stream)
+{
+   memvfs_handle_t *handle = (memvfs_handle_t*)stream;
+
+   if (handle->file)
+      return 0;
+   if (host)
+      return host->flush(handle->host);
+   return retro_vfs_file_flush_impl((libretro_vfs_implementation_file*)handle->host);
+}
+
+static int RETRO_CALLCONV memvfs_remove_cb(const char *path)
+{
+   return memvfs_remove(path);
+}
+
+static int RETRO_CALLCONV memvfs_rename(const char *old_path, const char *new_path)
+{
+   memvfs_file_t *file = memvfs_in_root(old_path) ? memvfs_find(old_path) : NULL;
+   char *tmp;
+
+   if (!file)
+   {
+      if (host)
+         return host->rename(old_path, new_path);
+      return retro_vfs_file_rename_impl(old_path, new_path);
+   }
+   if (!memvfs_in_root(new_path) || !(tmp = strdup(new_path)))
+      return -1;
+
+   if (memvfs_find(new_path))
+      memvfs_unlink(memvfs_find(new_path));
+   free(file->path);
+   file->path = tmp;
+   return 0;
+}
+
+static int RETRO_CALLCONV memvfs_stat_cb(const char *path, int32_t *size)
+{
+   return memvfs_stat(path, size);
+}
+
+static int RETRO_CALLCONV memvfs_mkdir(const char *dir)
+{
+   if (!memvfs_in_root(dir))
+      return host_mkdir(dir);
+
+   if (memvfs_is_directory(dir))
+      return -2;
+   if (memvfs_find(dir) || !memvfs_create(dir, true))
+      return -1;
+   return 0;
+}
+
+static struct retro_vfs_interface memvfs_iface =
+{
+   memvfs_get_path,
+   memvfs_open,
+   memvfs_close,
+   memvfs_size,
+   memvfs_tell,
+   memvfs_seek,
+   memvfs_read,
+   memvfs_write,
+   memvfs_flush,
+   memvfs_remove_cb,
+   memvfs_rename,
+   memvfs_truncate,
+   memvfs_stat_cb,
+   memvfs_mkdir,
+   NULL,
+   NULL,
+   NULL,
+   NULL,
+   NULL
+};
+
+void memvfs_init(const char *root, const struct retro_vfs_interface_info *host_info)
+{
+   struct retro_vfs_interface_info info;
+
+   memvfs_root  = root;
+   host         = host_info ? host_info->iface : NULL;
+   host_version = host ? host_info->required_interface_version : 0;
+
+   info.required_interface_version = 3;
+   info.iface                      = &memvfs_iface;
+   filestream_vfs_init(&info);
+   path_vfs_init(&info);
+}
+
+int memvfs_stat(const char *path, int32_t *size)
+{
+   memvfs_file_t *file;
+
+   if (memvfs_in_root(path))
+   {
+      file = memvfs_find(path);
+      if (file && !file->is_dir)
+      {
+         if (size)
+            *size = (int32_t)file->size;
+         return RETRO_VFS_STAT_IS_VALID;
+      }
+      if (memvfs_is_directory(path))
+         return RETRO_VFS_STAT_IS_VALID | RETRO_VFS_STAT_IS_DIRECTORY;
+   }
+   return host_stat(path, size);
+}
+
+bool memvfs_contains(const char *path)
+{
+   return memvfs_in_root(path) && (memvfs_find(path) || memvfs_is_directory(path));
+}
+
+int memvfs_remove(const char *path)
+{
+   memvfs_file_t *file = memvfs_in_root(path) ? memvfs_find(path) : NULL;
+
+   if (!file)
+      return host_remove(path);
+
+   memvfs_unlink(file);
+   return 0;
+}
+
+/* Drops all memory files, the namespace is used again afterwards */
+void memvfs_clear(void)
+{
+   while (memvfs_files)
+      memvfs_unlink(memvfs_files);
+   memvfs_exported = false;
+}
+
+/* Writes the memory files out below the root and hands the namespace over
+ * to the host, for consumers which walk the storage directly (the
+ * filesystem device) and need writes to land next to the files */
+void memvfs_export(void)
+{
+   memvfs_file_t *file;
+   char path[RETRO_PATH_MAX];
+   size_t i;
+
+   if (!memvfs_root || !*memvfs_root || memvfs_exported)
+      return;
+
+   host_mkdir(memvfs_root);
+   for (file = memvfs_files; file; file = file->next)
+   {
+      struct retro_vfs_file_handle *hfile;
+
+      /* Parent directories first */
+      snprintf(path, sizeof(path), "%s", file->path);
+      for (i = strlen(memvfs_root) + 1; path[i]; i++)
+      {
+         if (!memvfs_is_sep(path[i]))
+            continue;
+         path[i] = '\0';
+         host_mkdir(path);
+         path[i] = FSDEV_DIR_SEP_CHR;
+      }
+
+      if (file->is_dir)
+      {
+         host_mkdir(file->path);
+         continue;
+      }
+
+      hfile = host_open(file->path, RETRO_VFS_FILE_ACCESS_WRITE, RETRO_VFS_FILE_ACCESS_HINT_NONE);
+      if (!hfile || (file->size && host_write(hfile, file->data, file->size) != (int64_t)file->size))
+         log_cb(RETRO_LOG_ERROR, "Error writing temporary file %s\n", file->path);
+      if (hfile)
+         host_close(hfile);
+   }
+
+   memvfs_clear();
+   memvfs_exported = true;
+}
+
+/* Directory listing */
+static bool memvfs_dir_add(memvfs_dir_t *dir, const char *name, size_t len)
+{
+   unsigned i;
+
+   for (i = 0; i < dir->count; i++)
+      if (!strncmp(dir->names[i], name, len) && !dir->names[i][len])
+         return true;
+
+   if (dir->count == dir->alloc)
+   {
+      unsigned alloc = dir->alloc ? dir->alloc * 2 : 16;
+      char **names   = (char**)realloc(dir->names, alloc * sizeof(char*));
+      if (!names)
+         return false;
+      dir->names = names;
+      dir->alloc = alloc;
+   }
+
+   dir->names[dir->count] = (char*)malloc(len + 1);
+   if (!dir->names[dir->count])
+      return false;
+   memcpy(dir->names[dir->count], name, len);
+   dir->names[dir->count][len] = '\0';
+   dir->count++;
+   return true;
+}
+
+memvfs_dir_t *memvfs_opendir(const char *path)
+{
+   memvfs_dir_t *dir = (memvfs_dir_t*)calloc(1, sizeof(memvfs_dir_t));
+   DIR *host_dir;
+   struct dirent *host_dirp;
+   memvfs_file_t *file;
+
+   if (!dir)
+      return NULL;
+
+   if (memvfs_in_root(path))
+   {
+      for (file = memvfs_files; file; file = file->next)
+      {
+         const char *name;
+         size_t len = memvfs_prefix(file->path, path);
+
+         if (!len || !file->path[len])
+            continue;
+
+         name = file->path + len;
+         while (memvfs_is_sep(*name))
+            name++;
+         for (len = 0; name[len] && !memvfs_is_sep(name[len]); len++);
+         if (len)
+            memvfs_dir_add(dir, name, len);
+      }
+   }
+
+   host_dir = opendir(path);
+   if (host_dir)
+   {
+      while ((host_dirp = readdir(host_dir)) != NULL)
+      {
+         if (!strcmp(host_dirp->d_name, ".") || !strcmp(host_dirp->d_name, ".."))
+            continue;
+         memvfs_dir_add(dir, host_dirp->d_name, strlen(host_dirp->d_name));
+      }
+      closedir(host_dir);
+   }
+   else if (!memvfs_in_root(path))
+   {
+      free(dir);
+      return NULL;
+   }
+
+   return dir;
+}
+
+/* The returned name may be modified by the caller, like dirent.d_name */
+char *memvfs_readdir(memvfs_dir_t *dir)
+{
+   if (!dir || dir->index >= dir->count)
+      return NULL;
+   return dir->names[dir->index++];
+}
+
+void memvfs_closedir(memvfs_dir_t *dir)
+{
+   unsigned i;
+
+   if (!dir)
+      return;
+   for (i = 0; i < dir->count; i++)
+      free(dir->names[i]);
+   free(dir->names);
+   free(dir);
+}
@@ -0,0 +1,28 @@
+#ifndef LIBRETRO_MEMVFS_H
+#define LIBRETRO_MEMVFS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "libretro.h"
+
+/* RAM backed VFS layer: files created below the root directory (archive
+ * members, NIB->G64 conversions, decompressed images) live in memory
+ * buffers instead of on the storage, everything else is passed on to the
+ * frontend VFS. Paths keep their on-disk form, so loaders see no difference. */
+
+typedef struct memvfs_dir memvfs_dir_t;
+
+extern void memvfs_init(const char *root, const struct retro_vfs_interface_info *host_info);
+extern bool memvfs_contains(const char *path);
+extern int memvfs_stat(const char *path, int32_t *size);
+extern int memvfs_remove(const char *path);
+extern void memvfs_clear(void);
+extern void memvfs_export(void);
+
+/* Directory listing merging memory entries with the host directory */
+extern memvfs_dir_t *memvfs_opendir(const char *path);
+extern char *memvfs_readdir(memvfs_dir_t *dir);
+extern void memvfs_closedir(memvfs_dir_t *dir);
+
+#endif /* LIBRETRO_MEMVFS_H */
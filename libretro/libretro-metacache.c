@@ -0,0 +1,304 @@
+#include "libretro.h"
+#include "libretro-core.h"
+#include "libretro-memvfs.h"
+#include "libretro-metacache.h"
+
+#include "archdep.h"
+#include "crc32.h"
+
+#include "encodings/utf.h"
+#include "string/stdstring.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* Index file layout, integers little endian:
+ *   "VMCI", uint8 version, uint32 entry count,
+ *   entries of uint32 path CRC, uint32 size, uint32 mtime,
+ *              uint8 tag, uint8 index, uint8 length, data */
+#define METACACHE_FILE         "vice_metacache.idx"
+#define METACACHE_MAGIC        "VMCI"
+#define METACACHE_VERSION      1
+#define METACACHE_HEADER       9
+#define METACACHE_ENTRY_HEADER 15
+
+/* Entries kept, the oldest ones are dropped first */
+#define METACACHE_MAX_ENTRIES  4096
+
+extern retro_log_printf_t log_cb;
+extern char retro_temp_directory[RETRO_PATH_MAX];
+
+typedef struct metacache_entry
+{
+   uint32_t key;
+   uint32_t size;
+   uint32_t mtime;
+   uint8_t tag;
+   uint8_t index;
+   uint8_t len;
+   uint8_t data[METACACHE_DATA_MAX];
+} metacache_entry_t;
+
+static char *metacache_path                = NULL;
+static metacache_entry_t *metacache_list   = NULL;
+static unsigned metacache_count            = 0;
+static unsigned metacache_alloc            = 0;
+static bool metacache_loaded               = false;
+static bool metacache_dirty                = false;
+
+static uint32_t metacache_get_le(const uint8_t *buf)
+{
+   return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void metacache_put_le(uint8_t *buf, uint32_t value)
+{
+   buf[0] = value & 0xff;
+   buf[1] = (value >> 8) & 0xff;
+   buf[2] = (value >> 16) & 0xff;
+   buf[3] = (value >> 24) & 0xff;
+}
+
+/* Path CRC plus size and mtime of a regular file. Files in memory or in
+ * the temp directory are extracted anew each time and never cached. */
+static bool metacache_identity(const char *path, uint32_t *key, uint32_t *size, uint32_t *mtime)
+{
+   struct stat st;
+   int ret;
+
+   if (string_is_empty(path) || memvfs_contains(path)
+         || (!string_is_empty(retro_temp_directory) && string_starts_with(path, retro_temp_directory)))
+      return false;
+
+#ifdef USE_LIBRETRO_VFS
+   {
+      char *local = utf8_to_local_string_alloc(path);
+      ret = stat(local ? local : path, &st);
+      free(local);
+   }
+#else
+   ret = stat(path, &st);
+#endif
+   if (ret != 0 || !S_ISREG(st.st_mode))
+      return false;
+
+   *key   = crc32_buf(path, (unsigned int)strlen(path));
+   *size  = (uint32_t)st.st_size;
+   *mtime = (uint32_t)st.st_mtime;
+   return true;
+}
+
+static void metacache_load(void)
+{
+   uint8_t header[METACACHE_ENTRY_HEADER];
+   unsigned count, i;
+   FILE *fp;
+
+   metacache_loaded = true;
+   if (!metacache_path || !(fp = fopen(metacache_path, "rb")))
+      return;
+
+   if (fread(header, METACACHE_HEADER, 1, fp) != 1
+         || memcmp(header, METACACHE_MAGIC, 4)
+         || header[4] != METACACHE_VERSION)
+   {
+      log_cb(RETRO_LOG_WARN, "Ignoring invalid metadata cache '%s'\n", metacache_path);
+      fclose(fp);
+      return;
+   }
+
+   count = metacache_get_le(&header[5]);
+   if (count > METACACHE_MAX_ENTRIES)
+      count = METACACHE_MAX_ENTRIES;
+
+   metacache_list = (metacache_entry_t*)calloc(count ? count : 1, sizeof(metacache_entry_t));
+   if (!metacache_list)
+   {
+      fclose(fp);
+      return;
+   }
+   metacache_alloc = count ? count : 1;
+
+   for (i = 0; i < count; i++)
+   {
+      metacache_entry_t *entry = &metacache_list[metacache_count];
+
+      if (fread(header, METACACHE_ENTRY_HEADER, 1, fp) != 1)
+         break;
+      entry->key   = metacache_get_le(&header[0]);
+      entry->size  = metacache_get_le(&header[4]);
+      entry->mtime = metacache_get_le(&header[8]);
+      entry->tag   = header[12];
+      entry->index = header[13];
+      entry->len   = header[14];
+      if (entry->len && fread(entry->data, entry->len, 1, fp) != 1)
+         break;
+      metacache_count++;
+   }
+   fclose(fp);
+}
+
+static metacache_entry_t *metacache_find(uint32_t key, unsigned tag, unsigned index)
+{
+   unsigned i;
+
+   if (!metacache_loaded)
+      metacache_load();
+
+   for (i = 0; i < metacache_count; i++)
+   {
+      metacache_entry_t *entry = &metacache_list[i];
+      if (entry->key == key && entry->tag == tag && entry->index == index)
+         return entry;
+   }
+   return NULL;
+}
+
+void metacache_init(const char *dir)
+{
+   metacache_free();
+
+   if (string_is_empty(dir))
+      return;
+
+   metacache_path = (char*)malloc(strlen(dir) + strlen(FSDEV_DIR_SEP_STR) + strlen(METACACHE_FILE) + 1);
+   if (metacache_path)
+      sprintf(metacache_path, "%s%s%s", dir, FSDEV_DIR_SEP_STR, METACACHE_FILE);
+}
+
+void metacache_flush(void)
+{
+   uint8_t header[METACACHE_ENTRY_HEADER];
+   unsigned i;
+   FILE *fp;
+
+   if (!metacache_dirty || !metacache_path)
+      return;
+
+   if (!(fp = fopen(metacache_path, "wb")))
+   {
+      log_cb(RETRO_LOG_WARN, "Cannot write metadata cache '%s'\n", metacache_path);
+      return;
+   }
+
+   memcpy(header, METACACHE_MAGIC, 4);
+   header[4] = METACACHE_VERSION;
+   metacache_put_le(&header[5], metacache_count);
+   fwrite(header, METACACHE_HEADER, 1, fp);
+
+   for (i = 0; i < metacache_count; i++)
+   {
+      const metacache_entry_t *entry = &metacache_list[i];
+
+      metacache_put_le(&header[0], entry->key);
+      metacache_put_le(&header[4], entry->size);
+      metacache_put_le(&header[8], entry->mtime);
+      header[12] = entry->tag;
+      header[13] = entry->index;
+      header[14] = entry->len;
+      fwrite(header, METACACHE_ENTRY_HEADER, 1, fp);
+      if (entry->len)
+         fwrite(entry->data, entry->len, 1, fp);
+   }
+   fclose(fp);
+
+   metacache_dirty = false;
+}
+
+void metacache_free(void)
+{
+   free(metacache_path);
+   free(metacache_list);
+   metacache_path   = NULL;
+   metacache_list   = NULL;
+   metacache_count  = 0;
+   metacache_alloc  = 0;
+   metacache_loaded = false;
+   metacache_dirty  = false;
+}
+
+bool metacache_get(const char *path, unsigned tag, unsigned index, void *data, size_t *size)
+{
+   uint32_t key, file_size, mtime;
+   metacache_entry_t *entry;
+
+   if (!metacache_path || index > 0xff || !metacache_identity(path, &key, &file_size, &mtime))
+      return false;
+
+   entry = metacache_find(key, tag, index);
+   if (!entry || entry->size != file_size || entry->mtime != mtime || entry->len > *size)
+      return false;
+
+   memcpy(data, entry->data, entry->len);
+   *size = entry->len;
+   return true;
+}
+
+void metacache_set(const char *path, unsigned tag, unsigned index, const void *data, size_t size)
+{
+   uint32_t key, file_size, mtime;
+   metacache_entry_t *entry;
+
+   if (!metacache_path || index > 0xff || size > METACACHE_DATA_MAX
+         || !metacache_identity(path, &key, &file_size, &mtime))
+      return;
+
+   entry = metacache_find(key, tag, index);
+   if (!entry)
+   {
+      if (metacache_count == METACACHE_MAX_ENTRIES)
+      {
+         memmove(&metacache_list[0], &metacache_list[1], (metacache_count - 1) * sizeof(metacache_entry_t));
+         metacache_count--;
+      }
+      else if (metacache_count == metacache_alloc)
+      {
+         unsigned alloc = metacache_alloc ? metacache_alloc * 2 : 64;
+         metacache_entry_t *list;
+
+         if (alloc > METACACHE_MAX_ENTRIES)
+            alloc = METACACHE_MAX_ENTRIES;
+         list = (metacache_entry_t*)realloc(metacache_list, alloc * sizeof(metacache_entry_t));
+         if (!list)
+            return;
+         metacache_list  = list;
+         metacache_alloc = alloc;
+      }
+      entry        = &metacache_list[metacache_count++];
+      entry->key   = key;
+      entry->tag   = tag;
+      entry->index = index;
+   }
+   else if (entry->size == file_size && entry->mtime == mtime
+         && entry->len == size && !memcmp(entry->data, data, size))
+      return;
+
+   entry->size  = file_size;
+   entry->mtime = mtime;
+   entry->len   = (uint8_t)size;
+   memcpy(entry->data, data, size);
+   metacache_dirty = true;
+}
+
+bool metacache_get_int(const char *path, unsigned tag, unsigned index, int *value)
+{
+   uint8_t buf[4];
+   size_t size = sizeof(buf);
+
+   if (!metacache_get(path, tag, index, buf, &size) || size != sizeof(buf))
+      return false;
+
+   *value = (int)metacache_get_le(buf);
+   return true;
+}
+
+void metacache_set_int(const char *path, unsigned tag, unsigned index, int value)
+{
+   uint8_t buf[4];
+
+   metacache_put_le(buf, (uint32_t)value);
+   metacache_set(path, tag, index, buf, sizeof(buf));
+}
@@ -0,0 +1,31 @@
+#ifndef LIBRETRO_METACACHE_H
+#define LIBRETRO_METACACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Persistent cache of content probe results, so that loading the same
+ * images again (large M3U sets in particular) skips opening and probing
+ * every file. Entries are keyed by a CRC32 of the path and are only valid
+ * while the file size and modification time are unchanged. */
+
+#define METACACHE_DATA_MAX     255
+
+enum metacache_tag
+{
+   METACACHE_IMAGE_TYPE = 1,  /* Image type found by autostart detection */
+   METACACHE_PROGRAM_NAME,    /* Directory entry name, index = program number */
+   METACACHE_LABEL,           /* Raw disk or tape name from the image header */
+   METACACHE_CART_TYPE        /* VIC-20 cartridge type */
+};
+
+extern void metacache_init(const char *dir);
+extern void metacache_flush(void);
+extern void metacache_free(void);
+
+extern bool metacache_get(const char *path, unsigned tag, unsigned index, void *data, size_t *size);
+extern void metacache_set(const char *path, unsigned tag, unsigned index, const void *data, size_t size);
+extern bool metacache_get_int(const char *path, unsigned tag, unsigned index, int *value);
+extern void metacache_set_int(const char *path, unsigned tag, unsigned index, int value);
+
+#endif /* LIBRETRO_METACACHE_H */
@@ -0,0 +1,330 @@
+#include "libretro.h"
+#include "libretro-core.h"
+#include "libretro-rewind.h"
+
+#include "snapshot.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Record layout in the ring:
+ *   uint32 length, uint32 size of the restored state, uint8 type,
+ *   payload,
+ *   uint32 length (trailer for walking back from the head)
+ * Delta payload is a sequence of: uint16 skip, uint16 count, count XOR bytes */
+#define REWIND_RECORD_HEADER   9
+#define REWIND_RECORD_TRAILER  4
+#define REWIND_RECORD_OVERHEAD (REWIND_RECORD_HEADER + REWIND_RECORD_TRAILER)
+
+#define REWIND_TYPE_DELTA      0
+#define REWIND_TYPE_FULL       1
+
+/* Shortest run of unchanged bytes worth ending a literal run for */
+#define REWIND_MIN_SKIP        4
+#define REWIND_MAX_RUN         0xffff
+
+bool retro_rewinding = false;
+
+extern retro_log_printf_t log_cb;
+
+static uint8_t *ring        = NULL;
+static size_t ring_size     = 0;
+static size_t ring_head     = 0;  /* Write position, end of newest record */
+static size_t ring_tail     = 0;  /* Start of oldest record */
+static size_t ring_used     = 0;
+static unsigned ring_count  = 0;
+
+/* Newest state, the keyframe all deltas are applied to */
+static uint8_t *state       = NULL;
+static size_t state_size    = 0;
+static size_t state_alloc   = 0;
+
+/* Scratch for the incoming state and for encoded/popped records */
+static uint8_t *next        = NULL;
+static size_t next_alloc    = 0;
+static uint8_t *record      = NULL;
+static size_t record_alloc  = 0;
+
+static bool rewind_reserve(uint8_t **buf, size_t *alloc, size_t size)
+{
+   uint8_t *tmp;
+   if (*alloc >= size)
+      return true;
+   tmp = (uint8_t *)realloc(*buf, size);
+   if (!tmp)
+      return false;
+   *buf   = tmp;
+   *alloc = size;
+   return true;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+   p[0] = (uint8_t)v;
+   p[1] = (uint8_t)(v >> 8);
+   p[2] = (uint8_t)(v >> 16);
+   p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Ring access with wrap-around */
+static void ring_write(size_t pos, const uint8_t *src, size_t size)
+{
+   size_t first = ring_size - pos;
+   if (first >= size)
+      memcpy(ring + pos, src, size);
+   else
+   {
+      memcpy(ring + pos, src, first);
+      memcpy(ring, src + first, size - first);
+   }
+}
+
+static void ring_read(size_t pos, uint8_t *dst, size_t size)
+{
+   size_t first = ring_size - pos;
+   if (first >= size)
+      memcpy(dst, ring + pos, size);
+   else
+   {
+      memcpy(dst, ring + pos, first);
+      memcpy(dst + first, ring, size - first);
+   }
+}
+
+static void ring_drop_oldest(void)
+{
+   uint8_t len[4];
+   size_t length;
+
+   ring_read(ring_tail, len, sizeof(len));
+   length     = get_u32(len);
+   ring_tail  = (ring_tail + length) % ring_size;
+   ring_used -= length;
+   ring_count--;
+}
+
+/* Encode 'cur ^ prev' as skip/XOR runs into 'out', 0 if it does not fit 'out_max' */
+static size_t rewind_delta_encode(const uint8_t *cur, const uint8_t *prev, size_t size,
+                                  uint8_t *out, size_t out_max)
+{
+   size_t i = 0;
+   size_t o = 0;
+
+   while (i < size)
+   {
+      size_t skip  = 0;
+      size_t count = 0;
+      size_t k;
+
+      while (i < size && skip < REWIND_MAX_RUN && cur[i] == prev[i])
+      {
+         i++;
+         skip++;
+      }
+
+      while (i + count < size && count < REWIND_MAX_RUN)
+      {
+         size_t j = i + count;
+         if (cur[j] == prev[j]
+               && (j + REWIND_MIN_SKIP > size || !memcmp(cur + j, prev + j, REWIND_MIN_SKIP)))
+            break;
+         count++;
+      }
+
+      if (o + 4 + count > out_max)
+         return 0;
+
+      out[o++] = (uint8_t)skip;
+      out[o++] = (uint8_t)(skip >> 8);
+      out[o++] = (uint8_t)count;
+      out[o++] = (uint8_t)(count >> 8);
+      for (k = 0; k < count; k++)
+         out[o++] = cur[i + k] ^ prev[i + k];
+      i += count;
+   }
+
+   return o;
+}
+
+static void rewind_delta_apply(uint8_t *buf, const uint8_t *delta, size_t delta_size)
+{
+   const uint8_t *end = delta + delta_size;
+   size_t pos = 0;
+
+   while (delta < end)
+   {
+      size_t skip  = delta[0] | (delta[1] << 8);
+      size_t count = delta[2] | (delta[3] << 8);
+      size_t k;
+
+      delta += 4;
+      pos   += skip;
+      for (k = 0; k < count; k++)
+         buf[pos + k] ^= delta[k];
+      pos   += count;
+      delta += count;
+   }
+}
+
+void rewind_reset(void)
+{
+   ring_head  = 0;
+   ring_tail  = 0;
+   ring_used  = 0;
+   ring_count = 0;
+   state_size = 0;
+}
+
+void rewind_init(size_t capacity)
+{
+   if (capacity == ring_size)
+      return;
+
+   rewind_deinit();
+   if (!capacity)
+      return;
+
+   ring = (uint8_t *)malloc(capacity);
+   if (!ring)
+   {
+      log_cb(RETRO_LOG_ERROR, "Failed to allocate %u bytes for rewind\n", (unsigned)capacity);
+      return;
+   }
+   ring_size = capacity;
+   rewind_reset();
+}
+
+void rewind_deinit(void)
+{
+   free(ring);
+   free(state);
+   free(next);
+   free(record);
+   ring         = NULL;
+   state        = NULL;
+   next         = NULL;
+   record       = NULL;
+   ring_size    = 0;
+   state_alloc  = 0;
+   next_alloc   = 0;
+   record_alloc = 0;
+   retro_rewinding = false;
+   rewind_reset();
+}
+
+/* Capture the current frame, storing the previous keyframe as delta */
+void rewind_push(void)
+{
+   size_t size = retro_serialize_size();
+   size_t payload;
+   size_t length;
+   uint8_t type;
+   uint8_t *tmp;
+
+   if (!ring || !size)
+      return;
+
+   if (  !rewind_reserve(&next, &next_alloc, size)
+      || !rewind_reserve(&record, &record_alloc,
+            ((size > state_size) ? size : state_size) + REWIND_RECORD_OVERHEAD))
+      return;
+
+   if (!retro_serialize(next, size))
+      return;
+   /* Actual size written, the query may be larger */
+   size = snapshot_size_get() ? snapshot_size_get() : size;
+
+   if (state_size)
+   {
+      /* Same layout gives a sparse delta, otherwise store the keyframe as is */
+      type    = REWIND_TYPE_DELTA;
+      payload = 0;
+      if (state_size == size)
+         payload = rewind_delta_encode(next, state, size,
+               record + REWIND_RECORD_HEADER, state_size);
+      if (!payload)
+      {
+         type    = REWIND_TYPE_FULL;
+         payload = state_size;
+         memcpy(record + REWIND_RECORD_HEADER, state, state_size);
+      }
+
+      length = payload + REWIND_RECORD_OVERHEAD;
+      if (length > ring_size)
+         rewind_reset();
+      else
+      {
+         put_u32(record, (uint32_t)length);
+         put_u32(record + 4, (uint32_t)state_size);
+         record[8] = type;
+         put_u32(record + REWIND_RECORD_HEADER + payload, (uint32_t)length);
+
+         while (ring_used + length > ring_size)
+            ring_drop_oldest();
+
+         ring_write(ring_head, record, length);
+         ring_head  = (ring_head + length) % ring_size;
+         ring_used += length;
+         ring_count++;
+      }
+   }
+
+   /* The incoming state becomes the keyframe */
+   tmp         = state;
+   state       = next;
+   next        = tmp;
+   state_size  = size;
+   size        = state_alloc;
+   state_alloc = next_alloc;
+   next_alloc  = size;
+}
+
+/* Restore the frame before the keyframe, false when history is exhausted */
+bool rewind_step(void)
+{
+   uint8_t len[4];
+   size_t length;
+   size_t start;
+   size_t restored_size;
+
+   if (!ring || !state_size)
+      return false;
+
+   /* History exhausted, hold at the oldest frame */
+   if (!ring_count)
+   {
+      retro_unserialize_state(state, state_size);
+      return false;
+   }
+
+   ring_read((ring_head + ring_size - REWIND_RECORD_TRAILER) % ring_size, len, sizeof(len));
+   length = get_u32(len);
+   start  = (ring_head + ring_size - length) % ring_size;
+
+   if (!rewind_reserve(&record, &record_alloc, length))
+      return false;
+   ring_read(start, record, length);
+   restored_size = get_u32(record + 4);
+
+   if (record[8] == REWIND_TYPE_DELTA)
+      rewind_delta_apply(state, record + REWIND_RECORD_HEADER, length - REWIND_RECORD_OVERHEAD);
+   else
+   {
+      if (!rewind_reserve(&state, &state_alloc, restored_size))
+         return false;
+      memcpy(state, record + REWIND_RECORD_HEADER, restored_size);
+   }
+   state_size = restored_size;
+
+   ring_head  = start;
+   ring_used -= length;
+   ring_count--;
+
+   return retro_unserialize_state(state, state_size);
+}
@@ -0,0 +1,19 @@
+#ifndef LIBRETRO_REWIND_H
+#define LIBRETRO_REWIND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* In-core rewind: the newest snapshot is kept as keyframe, and every older
+ * frame is stored as a XOR/RLE delta against its successor in a fixed-size
+ * ring, so stepping back is a single delta apply on the keyframe. */
+
+extern bool retro_rewinding;
+
+extern void rewind_init(size_t capacity);
+extern void rewind_deinit(void);
+extern void rewind_reset(void);
+extern void rewind_push(void);
+extern bool rewind_step(void);
+
+#endif /* LIBRETRO_REWIND_H */
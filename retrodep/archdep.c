@@ -77,6 +77,7 @@
 #include "arch/shared/archdep_quote_unzip.c"
 
 #include "libretro-core.h"
+#include "libretro-memvfs.h"
 extern unsigned int opt_read_vicerc;
 extern char full_path[RETRO_PATH_MAX];
 extern char retro_temp_directory[RETRO_PATH_MAX];
@@ -669,6 +670,15 @@ int archdep_stat(const char *path, size_t *len, unsigned int *isdir)
 {
     struct stat statbuf;
 
+    if (memvfs_contains(path)) {
+        int32_t size = 0;
+        int flags = memvfs_stat(path, &size);
+
+        *len = (size_t)size;
+        *isdir = (flags & RETRO_VFS_STAT_IS_DIRECTORY) ? 1 : 0;
+        return 0;
+    }
+
     if (libretro_stat(path, &statbuf) != 0) {
         *len = -1;
         *isdir = 0;
@@ -54,6 +54,16 @@ char snapshot_version_magic_string[] = "VICE Version\032";
 static unsigned char snapshot_viceversion[4];
 static uint32_t snapshot_vicerevision;
 
+/* End offset of the last module written, reported by snapshot_module_close() */
+static size_t snapshot_size_written = 0;
+/* Size of the last complete snapshot, 0 when unknown or invalidated */
+static size_t snapshot_size_cached = 0;
+/* Set while a state of the cached layout is read, see snapshot_size_hold() */
+static int snapshot_size_held = 0;
+/* Writing or reading a run-ahead checkpoint, which leaves out the event
+   module and keeps the control port devices, only the user changes those */
+static int snapshot_checkpoint = 0;
+
 #define SNAPSHOT_MAGIC_LEN              19
 #define SNAPSHOT_VERSION_MAGIC_LEN      13
 
@@ -383,6 +393,14 @@ static int snapshot_memory_fseek(snapshot_stream_t *f, long offset, int whence)
 static int snapshot_memory_fclose(snapshot_stream_t *f)
 {
     snapshot_memory_stream_t* stream = container_of(f, snapshot_memory_stream_t, istream);
+
+    /* The buffer may be larger than the snapshot, clear the rest so the
+       module search ends at an empty header instead of stale data */
+    if (stream->write_mode && stream->buffer != NULL
+        && stream->stream_size < stream->buffer_size) {
+        memset(stream->buffer + stream->stream_size, 0,
+               stream->buffer_size - stream->stream_size);
+    }
     lib_free(stream);
     return 0;
 }
@@ -560,28 +578,67 @@ static int snapshot_write_byte_array(snapshot_stream_t *f, const uint8_t *data,
     return 0;
 }
 
+/* Word and dword arrays are stored little endian, which is the host layout
+   on everything but big endian targets: write those as one block, and swap
+   through a small bounce buffer otherwise. */
+#define SNAPSHOT_SWAP_CHUNK 256
+
 static int snapshot_write_word_array(snapshot_stream_t *f, const uint16_t *data, unsigned int num)
 {
-    unsigned int i;
+#ifdef WORDS_BIGENDIAN
+    uint8_t buf[SNAPSHOT_SWAP_CHUNK * 2];
+    unsigned int i, n;
 
-    for (i = 0; i < num; i++) {
-        if (snapshot_write_word(f, data[i]) < 0) {
+    while (num > 0) {
+        n = (num < SNAPSHOT_SWAP_CHUNK) ? num : SNAPSHOT_SWAP_CHUNK;
+        for (i = 0; i < n; i++) {
+            buf[i * 2]     = (uint8_t)(data[i] & 0xff);
+            buf[i * 2 + 1] = (uint8_t)(data[i] >> 8);
+        }
+        if (snapshot_write(f, buf, (size_t)n * 2) != 1) {
+            snapshot_error = SNAPSHOT_WRITE_EOF_ERROR;
             return -1;
         }
+        data += n;
+        num -= n;
+    }
+#else
+    if (num > 0 && snapshot_write(f, data, (size_t)num * 2) != 1) {
+        snapshot_error = SNAPSHOT_WRITE_EOF_ERROR;
+        return -1;
     }
+#endif
 
     return 0;
 }
 
 static int snapshot_write_dword_array(snapshot_stream_t *f, const uint32_t *data, unsigned int num)
 {
-    unsigned int i;
-
-    for (i = 0; i < num; i++) {
-        if (snapshot_write_dword(f, data[i]) < 0) {
+#ifdef WORDS_BIGENDIAN
+    uint8_t buf[SNAPSHOT_SWAP_CHUNK * 4];
+    unsigned int i, n;
+
+    while (num > 0) {
+        n = (num < SNAPSHOT_SWAP_CHUNK) ? num : SNAPSHOT_SWAP_CHUNK;
+        for (i = 0; i < n; i++) {
+            buf[i * 4]     = (uint8_t)(data[i] & 0xff);
+            buf[i * 4 + 1] = (uint8_t)(data[i] >> 8);
+            buf[i * 4 + 2] = (uint8_t)(data[i] >> 16);
+            buf[i * 4 + 3] = (uint8_t)(data[i] >> 24);
+        }
+        if (snapshot_write(f, buf, (size_t)n * 4) != 1) {
+            snapshot_error = SNAPSHOT_WRITE_EOF_ERROR;
             return -1;
         }
+        data += n;
+        num -= n;
+    }
+#else
+    if (num > 0 && snapshot_write(f, data, (size_t)num * 4) != 1) {
+        snapshot_error = SNAPSHOT_WRITE_EOF_ERROR;
+        return -1;
     }
+#endif
 
     return 0;
 }
@@ -670,29 +727,47 @@ static int snapshot_read_byte_array(snapshot_stream_t *f, uint8_t *b_return, uns
     return 0;
 }
 
+/* Read straight into the destination, swapping in place on big endian hosts */
 static int snapshot_read_word_array(snapshot_stream_t *f, uint16_t *w_return, unsigned int num)
 {
+#ifdef WORDS_BIGENDIAN
+    uint8_t *b = (uint8_t *)w_return;
     unsigned int i;
+#endif
 
-    for (i = 0; i < num; i++) {
-        if (snapshot_read_word(f, w_return + i) < 0) {
-            return -1;
-        }
+    if (num > 0 && snapshot_read(f, w_return, (size_t)num * 2) != 1) {
+        snapshot_error = SNAPSHOT_READ_EOF_ERROR;
+        return -1;
+    }
+
+#ifdef WORDS_BIGENDIAN
+    for (i = 0; i < num; i++, b += 2) {
+        w_return[i] = (uint16_t)(b[0] | (b[1] << 8));
     }
+#endif
 
     return 0;
 }
 
 static int snapshot_read_dword_array(snapshot_stream_t *f, uint32_t *dw_return, unsigned int num)
 {
+#ifdef WORDS_BIGENDIAN
+    uint8_t *b = (uint8_t *)dw_return;
     unsigned int i;
+#endif
 
-    for (i = 0; i < num; i++) {
-        if (snapshot_read_dword(f, dw_return + i) < 0) {
-            return -1;
-        }
+    if (num > 0 && snapshot_read(f, dw_return, (size_t)num * 4) != 1) {
+        snapshot_error = SNAPSHOT_READ_EOF_ERROR;
+        return -1;
     }
 
+#ifdef WORDS_BIGENDIAN
+    for (i = 0; i < num; i++, b += 4) {
+        dw_return[i] = (uint32_t)b[0] | ((uint32_t)b[1] << 8)
+                       | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+    }
+#endif
+
     return 0;
 }
 
@@ -1027,6 +1102,12 @@ snapshot_module_t *snapshot_module_open(snapshot_t *s, const char *name, uint8_t
             goto fail;
         }
 
+        /* An empty header is the padding after the last module */
+        if (m->size < SNAPSHOT_MODULE_NAME_LEN + 6) {
+            snapshot_error = SNAPSHOT_MODULE_NOT_FOUND_ERROR;
+            goto fail;
+        }
+
         /* Found?  */
         if (memcmp(n, name, name_len) == 0
             && (name_len == SNAPSHOT_MODULE_NAME_LEN || n[name_len] == 0)) {
@@ -1060,6 +1141,11 @@ int snapshot_module_close(snapshot_module_t *m)
         return -1;
     }
 
+    /* Report module extent for the size cache */
+    if (m->write_mode && (size_t)(m->offset + m->size) > snapshot_size_written) {
+        snapshot_size_written = (size_t)(m->offset + m->size);
+    }
+
     /* Skip module.  */
     if (snapshot_fseek(m->file, m->offset + m->size, SEEK_SET) < 0) {
         snapshot_error = SNAPSHOT_MODULE_SKIP_ERROR;
@@ -1125,6 +1211,8 @@ snapshot_t *snapshot_create_from_stream(snapshot_stream_t *f, uint8_t major_vers
     s->first_module_offset = snapshot_ftell(f);
     s->write_mode = 1;
 
+    snapshot_size_written = (size_t)s->first_module_offset;
+
     return s;
 
 fail:
@@ -1289,6 +1377,71 @@ static void display_error_with_vice_version(char *text, char *filename)
     lib_free(vmessage);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Snapshot size cache */
+
+/* Commit the size of the last snapshot written as the cached size.
+   Call only after a complete and successful write. The cache only grows
+   until it is invalidated, so the size reported to the frontend is stable. */
+void snapshot_size_update(void)
+{
+    if (snapshot_size_written > snapshot_size_cached) {
+        snapshot_size_cached = snapshot_size_written;
+    }
+}
+
+/* Cached snapshot size plus SNAPSHOT_SIZE_HEADROOM, 0 if a new measurement
+   is needed */
+size_t snapshot_size_get(void)
+{
+    if (snapshot_size_cached == 0) {
+        return 0;
+    }
+    return snapshot_size_cached + SNAPSHOT_SIZE_HEADROOM;
+}
+
+/* Drop the cached size after memory, cartridge or drive configuration changes */
+void snapshot_size_invalidate(void)
+{
+    if (!snapshot_size_held) {
+        snapshot_size_cached = 0;
+    }
+}
+
+/* Reading a state detaches and reattaches its disks and cartridges. When the
+   state has the cached layout that ends where it started, so the caller
+   holds the cache for the duration of the read. */
+void snapshot_size_hold(int hold)
+{
+    snapshot_size_held = hold;
+}
+
+int snapshot_is_checkpoint(void)
+{
+    return snapshot_checkpoint;
+}
+
+/* Volatile machine state only: CPUs, chips and RAM, without ROMs or disks */
+int machine_write_checkpoint_to_stream(snapshot_stream_t *stream)
+{
+    int result;
+
+    snapshot_checkpoint = 1;
+    result = machine_write_snapshot_to_stream(stream, 0, 0, 0);
+    snapshot_checkpoint = 0;
+    return result;
+}
+
+int machine_read_checkpoint_from_stream(snapshot_stream_t *stream)
+{
+    int result;
+
+    snapshot_checkpoint = 1;
+    result = machine_read_snapshot_from_stream(stream, 0);
+    snapshot_checkpoint = 0;
+    return result;
+}
+
 void snapshot_display_error(void)
 {
     switch (snapshot_error) {
@@ -1491,7 +1644,7 @@ int c64_snapshot_write_to_stream(snapshot_stream_t *stream, int save_roms, int s
         || drive_snapshot_write_module(s, save_disks, save_roms) < 0
         || vicii_snapshot_write_module(s) < 0
         || c64_glue_snapshot_write_module(s) < 0
-        || event_snapshot_write_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_write_module(s, event_mode) < 0)
         || memhacks_snapshot_write_modules(s) < 0
         || tapeport_snapshot_write_module(s, save_disks) < 0
         || keyboard_snapshot_write_module(s) < 0
@@ -1524,7 +1677,9 @@ int c64_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
 
     vicii_snapshot_prepare();
 
-    joyport_clear_devices();
+    if (!snapshot_checkpoint) {
+        joyport_clear_devices();
+    }
 
     if (maincpu_snapshot_read_module(s) < 0
         || c64_snapshot_read_module(s) < 0
@@ -1534,7 +1689,7 @@ int c64_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
         || drive_snapshot_read_module(s) < 0
         || vicii_snapshot_read_module(s) < 0
         || c64_glue_snapshot_read_module(s) < 0
-        || event_snapshot_read_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_read_module(s, event_mode) < 0)
         || memhacks_snapshot_read_modules(s) < 0
         || tapeport_snapshot_read_module(s) < 0
         || keyboard_snapshot_read_module(s) < 0
@@ -1601,7 +1756,7 @@ int c64dtv_snapshot_write_to_stream(snapshot_stream_t *stream, int save_roms, in
         || sid_snapshot_write_module(s) < 0
         || drive_snapshot_write_module(s, save_disks, save_roms) < 0
         || vicii_snapshot_write_module(s) < 0
-        || event_snapshot_write_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_write_module(s, event_mode) < 0)
         || keyboard_snapshot_write_module(s) < 0
         || joyport_snapshot_write_module(s, JOYPORT_1) < 0
         || joyport_snapshot_write_module(s, JOYPORT_2) < 0
@@ -1632,7 +1787,9 @@ int c64dtv_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
 
     vicii_snapshot_prepare();
 
-    joyport_clear_devices();
+    if (!snapshot_checkpoint) {
+        joyport_clear_devices();
+    }
 
     if (maincpu_snapshot_read_module(s) < 0
         || c64dtv_snapshot_read_module(s) < 0
@@ -1644,7 +1801,7 @@ int c64dtv_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
         || sid_snapshot_read_module(s) < 0
         || drive_snapshot_read_module(s) < 0
         || vicii_snapshot_read_module(s) < 0
-        || event_snapshot_read_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_read_module(s, event_mode) < 0)
         || keyboard_snapshot_read_module(s) < 0
         || joyport_snapshot_read_module(s, JOYPORT_1) < 0
         || joyport_snapshot_read_module(s, JOYPORT_2) < 0
@@ -1701,7 +1858,7 @@ int c128_snapshot_write_to_stream(snapshot_stream_t *stream, int save_roms, int
         || sid_snapshot_write_module(s) < 0
         || drive_snapshot_write_module(s, save_disks, save_roms) < 0
         || vicii_snapshot_write_module(s) < 0
-        || event_snapshot_write_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_write_module(s, event_mode) < 0)
         || tapeport_snapshot_write_module(s, save_disks) < 0
         || keyboard_snapshot_write_module(s) < 0
         || joyport_snapshot_write_module(s, JOYPORT_1) < 0
@@ -1733,7 +1890,9 @@ int c128_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
 
     vicii_snapshot_prepare();
 
-    joyport_clear_devices();
+    if (!snapshot_checkpoint) {
+        joyport_clear_devices();
+    }
 
     if (maincpu_snapshot_read_module(s) < 0
         || c128_snapshot_read_module(s) < 0
@@ -1742,7 +1901,7 @@ int c128_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
         || sid_snapshot_read_module(s) < 0
         || drive_snapshot_read_module(s) < 0
         || vicii_snapshot_read_module(s) < 0
-        || event_snapshot_read_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_read_module(s, event_mode) < 0)
         || tapeport_snapshot_read_module(s) < 0
         || keyboard_snapshot_read_module(s) < 0
         || joyport_snapshot_read_module(s, JOYPORT_1) < 0
@@ -1804,7 +1963,7 @@ int cbm2_snapshot_write_to_stream(snapshot_stream_t *stream, int save_roms, int
         || acia1_snapshot_write_module(s) < 0
         || sid_snapshot_write_module(s) < 0
         || drive_snapshot_write_module(s, save_disks, save_roms) < 0
-        || event_snapshot_write_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_write_module(s, event_mode) < 0)
         || tapeport_snapshot_write_module(s, save_disks) < 0
         || keyboard_snapshot_write_module(s) < 0
         || userport_snapshot_write_module(s) < 0) {
@@ -1842,7 +2001,7 @@ int cbm2_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
         || acia1_snapshot_read_module(s) < 0
         || sid_snapshot_read_module(s) < 0
         || drive_snapshot_read_module(s) < 0
-        || event_snapshot_read_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_read_module(s, event_mode) < 0)
         || tapeport_snapshot_read_module(s) < 0
         || keyboard_snapshot_read_module(s) < 0
         || userport_snapshot_read_module(s) < 0) {
@@ -1902,7 +2061,7 @@ int cbm2_snapshot_write_to_stream(snapshot_stream_t *stream, int save_roms, int
         || drive_snapshot_write_module(s, save_disks, save_roms) < 0
         || vicii_snapshot_write_module(s) < 0
         || cbm2_c500_snapshot_write_module(s) < 0
-        || event_snapshot_write_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_write_module(s, event_mode) < 0)
         || tapeport_snapshot_write_module(s, save_disks) < 0
         || keyboard_snapshot_write_module(s) < 0
         || joyport_snapshot_write_module(s, JOYPORT_1) < 0
@@ -1934,7 +2093,9 @@ int cbm2_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
 
     vicii_snapshot_prepare();
 
-    joyport_clear_devices();
+    if (!snapshot_checkpoint) {
+        joyport_clear_devices();
+    }
 
     if (maincpu_snapshot_read_module(s) < 0
         || vicii_snapshot_read_module(s) < 0
@@ -1946,7 +2107,7 @@ int cbm2_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
         || acia1_snapshot_read_module(s) < 0
         || sid_snapshot_read_module(s) < 0
         || drive_snapshot_read_module(s) < 0
-        || event_snapshot_read_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_read_module(s, event_mode) < 0)
         || tapeport_snapshot_read_module(s) < 0
         || keyboard_snapshot_read_module(s) < 0
         || joyport_snapshot_read_module(s, JOYPORT_1) < 0
@@ -2008,7 +2169,7 @@ int pet_snapshot_write_to_stream(snapshot_stream_t *stream, int save_roms, int s
         || petdww_snapshot_write_module(s) < 0
         || viacore_snapshot_write_module(machine_context.via, s) < 0
         || drive_snapshot_write_module(s, save_disks, save_roms) < 0
-        || event_snapshot_write_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_write_module(s, event_mode) < 0)
         || tapeport_snapshot_write_module(s, save_disks) < 0
         || keyboard_snapshot_write_module(s) < 0
         || userport_snapshot_write_module(s) < 0) {
@@ -2052,7 +2213,7 @@ int pet_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
         || petdww_snapshot_read_module(s) < 0
         || viacore_snapshot_read_module(machine_context.via, s) < 0
         || drive_snapshot_read_module(s) < 0
-        || event_snapshot_read_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_read_module(s, event_mode) < 0)
         || tapeport_snapshot_read_module(s) < 0
         || keyboard_snapshot_read_module(s) < 0
         || userport_snapshot_read_module(s) < 0) {
@@ -2109,7 +2270,7 @@ int plus4_snapshot_write_to_stream(snapshot_stream_t *stream, int save_roms, int
         || plus4_snapshot_write_module(s, save_roms) < 0
         || drive_snapshot_write_module(s, save_disks, save_roms) < 0
         || ted_snapshot_write_module(s) < 0
-        || event_snapshot_write_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_write_module(s, event_mode) < 0)
         || tapeport_snapshot_write_module(s, save_disks) < 0
         || keyboard_snapshot_write_module(s) < 0
         || joyport_snapshot_write_module(s, JOYPORT_1) < 0
@@ -2144,13 +2305,15 @@ int plus4_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
 
     ted_snapshot_prepare();
 
-    joyport_clear_devices();
+    if (!snapshot_checkpoint) {
+        joyport_clear_devices();
+    }
 
     if (maincpu_snapshot_read_module(s) < 0
         || plus4_snapshot_read_module(s) < 0
         || drive_snapshot_read_module(s) < 0
         || ted_snapshot_read_module(s) < 0
-        || event_snapshot_read_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_read_module(s, event_mode) < 0)
         || tapeport_snapshot_read_module(s) < 0
         || keyboard_snapshot_read_module(s) < 0
         || joyport_snapshot_read_module(s, JOYPORT_1) < 0
@@ -2214,7 +2377,7 @@ int scpu64_snapshot_write_to_stream(snapshot_stream_t *stream, int save_roms, in
         || drive_snapshot_write_module(s, save_disks, save_roms) < 0
         || vicii_snapshot_write_module(s) < 0
         || scpu64_glue_snapshot_write_module(s) < 0
-        || event_snapshot_write_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_write_module(s, event_mode) < 0)
         || keyboard_snapshot_write_module(s) < 0
         || joyport_snapshot_write_module(s, JOYPORT_1) < 0
         || joyport_snapshot_write_module(s, JOYPORT_2) < 0
@@ -2245,7 +2408,9 @@ int scpu64_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
 
     vicii_snapshot_prepare();
 
-    joyport_clear_devices();
+    if (!snapshot_checkpoint) {
+        joyport_clear_devices();
+    }
 
     if (maincpu_snapshot_read_module(s) < 0
         || scpu64_snapshot_read_module(s) < 0
@@ -2255,7 +2420,7 @@ int scpu64_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
         || drive_snapshot_read_module(s) < 0
         || vicii_snapshot_read_module(s) < 0
         || scpu64_glue_snapshot_read_module(s) < 0
-        || event_snapshot_read_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_read_module(s, event_mode) < 0)
         || keyboard_snapshot_read_module(s) < 0
         || joyport_snapshot_read_module(s, JOYPORT_1) < 0
         || joyport_snapshot_read_module(s, JOYPORT_2) < 0
@@ -2315,7 +2480,7 @@ int vic20_snapshot_write_to_stream(snapshot_stream_t *stream, int save_roms, int
         || viacore_snapshot_write_module(machine_context.via1, s) < 0
         || viacore_snapshot_write_module(machine_context.via2, s) < 0
         || drive_snapshot_write_module(s, save_disks, save_roms) < 0
-        || event_snapshot_write_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_write_module(s, event_mode) < 0)
         || tapeport_snapshot_write_module(s, save_disks) < 0
         || keyboard_snapshot_write_module(s) < 0
         || joyport_snapshot_write_module(s, JOYPORT_1) < 0
@@ -2353,7 +2518,9 @@ int vic20_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
         goto fail;
     }
 
-    joyport_clear_devices();
+    if (!snapshot_checkpoint) {
+        joyport_clear_devices();
+    }
 
     /* FIXME: Missing sound.  */
     if (maincpu_snapshot_read_module(s) < 0
@@ -2362,7 +2529,7 @@ int vic20_snapshot_read_from_stream(snapshot_stream_t *stream, int event_mode)
         || viacore_snapshot_read_module(machine_context.via1, s) < 0
         || viacore_snapshot_read_module(machine_context.via2, s) < 0
         || drive_snapshot_read_module(s) < 0
-        || event_snapshot_read_module(s, event_mode) < 0
+        || (!snapshot_checkpoint && event_snapshot_read_module(s, event_mode) < 0)
         || tapeport_snapshot_read_module(s) < 0
         || keyboard_snapshot_read_module(s) < 0
         || joyport_snapshot_read_module(s, JOYPORT_1) < 0
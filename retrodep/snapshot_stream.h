@@ -142,6 +142,10 @@ extern int machine_write_snapshot_to_stream(struct snapshot_stream_s *stream, in
 
 extern int machine_read_snapshot_from_stream(struct snapshot_stream_s *stream, int event_mode);
 
+/* Run-ahead checkpoint, the volatile subset of the machine snapshot */
+extern int machine_write_checkpoint_to_stream(struct snapshot_stream_s *stream);
+extern int machine_read_checkpoint_from_stream(struct snapshot_stream_s *stream);
+
 extern int snapshot_free(snapshot_t *s);
 
 extern snapshot_t *snapshot_create_from_stream(snapshot_stream_t *f,
@@ -166,4 +170,15 @@ extern long snapshot_ftell(snapshot_stream_t *f);
 extern int snapshot_fclose(snapshot_stream_t *f);
 extern int snapshot_fclose_erase(snapshot_stream_t *f);
 
+/* Size cache */
+
+/* Room for a state that grows between the size query and the write */
+#define SNAPSHOT_SIZE_HEADROOM 0x4000
+
+extern void snapshot_size_update(void);
+extern size_t snapshot_size_get(void);
+extern void snapshot_size_invalidate(void);
+extern void snapshot_size_hold(int hold);
+extern int snapshot_is_checkpoint(void);
+
 #endif
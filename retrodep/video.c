@@ -20,10 +20,31 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ZOOM_SCAN_SSE2
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(__BIG_ENDIAN__) && !defined(__ARMEB__)
+#include <arm_neon.h>
+#define ZOOM_SCAN_NEON
+#endif
+
 #include "libretro-core.h"
 
 int machine_ui_done = 0;
 
+/* Frame change detection, previous palettized rows of the rendered area */
+bool retro_frame_dirty = true;
+bool retro_frame_force_dirty = true;
+static uint8_t *frame_prev = NULL;
+static size_t frame_prev_alloc = 0;
+static unsigned frame_prev_pitch = 0;
+static unsigned frame_prev_xs = 0;
+static unsigned frame_prev_w = 0;
+static unsigned frame_prev_ys = 0;
+static unsigned frame_prev_h = 0;
+/* Refreshes were skipped, whose dirty areas the next shown frame lacks */
+static bool frame_skipped = false;
+
 static const cmdline_option_t cmdline_options[] = {
      { NULL }
 };
@@ -92,30 +113,279 @@ int video_canvas_set_palette(struct video_canvas_s *canvas,
    }
    video_render_initraw(canvas->videoconfig);
 
+   /* Same draw buffer gives different pixels */
+   retro_frame_force_dirty = true;
+
    return 0;
 }
 
+/* Auto zoom border scan. Pixels are read as 16-bit values with 'step' 1 for
+ * 16-bit and 2 for 32-bit modes, where only the low half is compared.
+ * The vector paths test 8 pixels at a time as 32-bit lanes and leave the
+ * exact position inside a hit block to the scalar tail loop. */
+#if defined(ZOOM_SCAN_SSE2)
+static void zoom_scan_load(const uint16_t *p, unsigned step, __m128i *a, __m128i *b)
+{
+   if (step == 1)
+   {
+      __m128i v = _mm_loadu_si128((const __m128i *)p);
+      *a = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+      *b = _mm_unpackhi_epi16(v, _mm_setzero_si128());
+   }
+   else
+   {
+      *a = _mm_and_si128(_mm_loadu_si128((const __m128i *)p), _mm_set1_epi32(0xffff));
+      *b = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + 8)), _mm_set1_epi32(0xffff));
+   }
+}
+#elif defined(ZOOM_SCAN_NEON)
+static void zoom_scan_load(const uint16_t *p, unsigned step, int32x4_t *a, int32x4_t *b)
+{
+   if (step == 1)
+   {
+      uint16x8_t v = vld1q_u16(p);
+      *a = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(v)));
+      *b = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(v)));
+   }
+   else
+   {
+      *a = vreinterpretq_s32_u32(vandq_u32(vld1q_u32((const uint32_t *)p), vdupq_n_u32(0xffff)));
+      *b = vreinterpretq_s32_u32(vandq_u32(vld1q_u32((const uint32_t *)(p + 8)), vdupq_n_u32(0xffff)));
+   }
+}
+
+static unsigned zoom_scan_any(uint32x4_t m)
+{
+   uint32x2_t t = vorr_u32(vget_low_u32(m), vget_high_u32(m));
+   return vget_lane_u32(vpmax_u32(t, t), 0);
+}
+#endif
+
+/* First pixel from 'j' on that differs from 'color' by more than 'diff' */
+static unsigned zoom_scan_diff(const uint16_t *row, unsigned step,
+      unsigned j, unsigned end, int color, int diff)
+{
+#if defined(ZOOM_SCAN_SSE2)
+   const __m128i c  = _mm_set1_epi32(color);
+   const __m128i hi = _mm_set1_epi32(diff);
+   const __m128i lo = _mm_set1_epi32(-diff);
+   __m128i a, b, m;
+
+   for (; j + 8 <= end; j += 8)
+   {
+      zoom_scan_load(row + j * step, step, &a, &b);
+      a = _mm_sub_epi32(a, c);
+      b = _mm_sub_epi32(b, c);
+      m = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(a, hi), _mm_cmplt_epi32(a, lo)),
+                       _mm_or_si128(_mm_cmpgt_epi32(b, hi), _mm_cmplt_epi32(b, lo)));
+      if (_mm_movemask_epi8(m))
+         break;
+   }
+#elif defined(ZOOM_SCAN_NEON)
+   const int32x4_t c = vdupq_n_s32(color);
+   const int32x4_t d = vdupq_n_s32(diff);
+   int32x4_t a, b;
+
+   for (; j + 8 <= end; j += 8)
+   {
+      zoom_scan_load(row + j * step, step, &a, &b);
+      if (zoom_scan_any(vorrq_u32(vcgtq_s32(vabsq_s32(vsubq_s32(a, c)), d),
+                                  vcgtq_s32(vabsq_s32(vsubq_s32(b, c)), d))))
+         break;
+   }
+#endif
+
+   for (; j < end; j++)
+      if (abs(row[j * step] - color) > diff)
+         return j;
+
+   return end;
+}
+
+/* Whether a pixel from 'j' on equals 'color' */
+static bool zoom_scan_equal(const uint16_t *row, unsigned step,
+      unsigned j, unsigned end, int color)
+{
+#if defined(ZOOM_SCAN_SSE2)
+   const __m128i c = _mm_set1_epi32(color);
+   __m128i a, b;
+
+   for (; j + 8 <= end; j += 8)
+   {
+      zoom_scan_load(row + j * step, step, &a, &b);
+      if (_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi32(a, c), _mm_cmpeq_epi32(b, c))))
+         return true;
+   }
+#elif defined(ZOOM_SCAN_NEON)
+   const int32x4_t c = vdupq_n_s32(color);
+   int32x4_t a, b;
+
+   for (; j + 8 <= end; j += 8)
+   {
+      zoom_scan_load(row + j * step, step, &a, &b);
+      if (zoom_scan_any(vorrq_u32(vceqq_s32(a, c), vceqq_s32(b, c))))
+         return true;
+   }
+#endif
+
+   for (; j < end; j++)
+      if (row[j * step] == color)
+         return true;
+
+   return false;
+}
+
+/* Pixel color per row must return to the background color
+ * in order to count as a show-worthy row, otherwise
+ * loaders with flashing borders would count as hits */
+static bool zoom_scan_row(unsigned line, int diff)
+{
+   const uint16_t *row = (const uint16_t *)retro_bmp + line * (retrow << (pix_bytes >> 2));
+   unsigned step  = pix_bytes >> 1;
+   unsigned pad   = 8;
+   unsigned start = ZOOM_LEFT_BORDER + pad;
+   unsigned end   = retrow - ZOOM_LEFT_BORDER - pad;
+   int color      = row[start * step];
+   unsigned j     = zoom_scan_diff(row, step, start, end, color, diff);
+
+   return (j < end && zoom_scan_equal(row, step, j + 1, end, color));
+}
+
+/* Compare the draw buffer rows about to be rendered against the previous
+ * frame and keep the copy current. Whole rows plus one above are compared,
+ * as filters may read neighbouring pixels. */
+static bool video_canvas_changed(struct video_canvas_s *canvas,
+      unsigned xs, unsigned ys, unsigned w, unsigned h)
+{
+   const uint8_t *src;
+   unsigned pitch;
+   unsigned i;
+   size_t size;
+   bool changed = retro_frame_force_dirty;
+
+   if (!canvas->draw_buffer || !canvas->draw_buffer->draw_buffer)
+      return true;
+
+   if (ys)
+   {
+      ys--;
+      h++;
+   }
+   if (ys + h > canvas->draw_buffer->draw_buffer_height)
+      h = (ys < canvas->draw_buffer->draw_buffer_height) ? canvas->draw_buffer->draw_buffer_height - ys : 0;
+
+   pitch = canvas->draw_buffer->draw_buffer_width;
+   src   = canvas->draw_buffer->draw_buffer + ys * pitch;
+   size  = (size_t)pitch * h;
+
+   if (size > frame_prev_alloc)
+   {
+      uint8_t *tmp = (uint8_t *)realloc(frame_prev, size);
+      if (!tmp)
+         return true;
+      frame_prev       = tmp;
+      frame_prev_alloc = size;
+      changed          = true;
+   }
+
+   if (  pitch != frame_prev_pitch
+      || xs != frame_prev_xs || w != frame_prev_w
+      || ys != frame_prev_ys || h != frame_prev_h)
+   {
+      frame_prev_pitch = pitch;
+      frame_prev_xs    = xs;
+      frame_prev_w     = w;
+      frame_prev_ys    = ys;
+      frame_prev_h     = h;
+      changed          = true;
+   }
+
+   if (changed)
+      memcpy(frame_prev, src, size);
+   else
+   {
+      for (i = 0; i < h; i++)
+      {
+         if (memcmp(frame_prev + i * pitch, src + i * pitch, pitch))
+         {
+            memcpy(frame_prev + i * pitch, src + i * pitch, size - i * pitch);
+            changed = true;
+            break;
+         }
+      }
+   }
+
+   retro_frame_force_dirty = false;
+   return changed;
+}
+
 void video_canvas_refresh(struct video_canvas_s *canvas,
       unsigned int xs, unsigned int ys,
       unsigned int xi, unsigned int yi,
       unsigned int w, unsigned int h)
 { 
    unsigned i = 0;
-   unsigned j = 0;
    unsigned color_diff = 0;
    unsigned zoom_bottom_border = 0;
+   int x0, y0, x1, y1;
 
 #ifdef RETRO_DEBUG
    printf("XS:%d YS:%d XI:%d YI:%d W:%d H:%d\n",xs,ys,xi,yi,w,h);
 #endif
 
-   video_canvas_render(
-         canvas, (uint8_t *)&retro_bmp,
-         retrow, retroh,
-         retroXS, retroYS,
-         0, 0, /*xi, yi,*/
-         retrow*pix_bytes, 8*pix_bytes
-   );
+   /* Frame is not going to be shown */
+   if (retro_skip_video)
+   {
+      frame_skipped = true;
+      return;
+   }
+
+   /* Dirty region in retro_bmp coordinates, where the canvas starts at
+    * retroXS/retroYS. Zoom modes other than automatic only show the
+    * cropped viewport, automatic zoom scans the borders of the full canvas.
+    * The viewport keeps the same margin as raster-canvas.c adds for the
+    * CRT emulation, which blurs neighbouring pixels into the edges */
+   if (frame_skipped)
+   {
+      x0 = 0;
+      y0 = 0;
+      x1 = (int)retrow;
+      y1 = (int)retroh;
+      frame_skipped           = false;
+      retro_frame_force_dirty = true;
+   }
+   else
+   {
+      x0 = (int)xs - (int)retroXS;
+      y0 = (int)ys - (int)retroYS;
+      x1 = x0 + (int)w;
+      y1 = y0 + (int)h;
+   }
+   if (zoom_mode_id != ZOOM_MODE_AUTO)
+   {
+      x0 = MAX(x0, (int)retroXS_offset - 4);
+      y0 = MAX(y0, (int)retroYS_offset - 1);
+      x1 = MIN(x1, (int)(retroXS_offset + zoomed_width) + 4);
+      y1 = MIN(y1, (int)(retroYS_offset + zoomed_height) + 1);
+   }
+   x0 = MAX(x0, 0);
+   y0 = MAX(y0, 0);
+   x1 = MIN(x1, (int)retrow);
+   y1 = MIN(y1, (int)retroh);
+
+   /* Unchanged frame leaves the previous render in place */
+   if (x1 > x0 && y1 > y0
+         && video_canvas_changed(canvas, retroXS + x0, retroYS + y0, x1 - x0, y1 - y0))
+   {
+      retro_frame_dirty = true;
+      video_canvas_render(
+            canvas, (uint8_t *)&retro_bmp,
+            x1 - x0, y1 - y0,
+            retroXS + x0, retroYS + y0,
+            x0, y0,
+            retrow*pix_bytes, 8*pix_bytes
+      );
+   }
 
    if (!retroh || zoom_mode_id < ZOOM_MODE_AUTO)
       return;
@@ -127,40 +397,20 @@ void video_canvas_refresh(struct video_canvas_s *canvas,
    switch (zoom_mode_id)
    {
       case ZOOM_MODE_AUTO:
-         /* Pixel color per row must return to the background color
-          * in order to count as a show-worthy row, otherwise
-          * loaders with flashing borders would count as hits */
          color_diff         = 3000 * pix_bytes;
          zoom_bottom_border = ZOOM_TOP_BORDER + ZOOM_HEIGHT_MAX;
 
          /* Top border, start from top */
          for (i = 0; i < ZOOM_TOP_BORDER && !vice_raster.blanked; i++)
          {
-            unsigned row   = i * (retrow << (pix_bytes >> 2));
-            unsigned pad   = 8;
-            unsigned col_x = row + (ZOOM_LEFT_BORDER + pad) * (pix_bytes >> 1);
-            unsigned color = retro_bmp[col_x];
-            unsigned found = 0;
-
-            for (j = ZOOM_LEFT_BORDER + pad; j < retrow - ZOOM_LEFT_BORDER - pad; j++)
+            if (zoom_scan_row(i, color_diff))
             {
-               unsigned pixel = row + j * (pix_bytes >> 1);
-
-               if (abs(retro_bmp[pixel] - color) > color_diff)
-                  found++;
-
-               if (found && retro_bmp[pixel] == color)
-               {
 #if 0
-                  printf("%s: FRST %3d %3d, %3d %d\n", __func__, i, j, found, color);
+               printf("%s: FRST %3d\n", __func__, i);
 #endif
-                  vice_raster.first_line = i;
-                  break;
-               }
-            }
-
-            if (vice_raster.first_line < ZOOM_TOP_BORDER)
+               vice_raster.first_line = i;
                break;
+            }
          }
 
          /* Allow bottom border upwards a few rows if top border is not used much.
@@ -171,31 +421,15 @@ void video_canvas_refresh(struct video_canvas_s *canvas,
          /* Bottom border, start from bottom, almost */
          for (i = retroh - 2; i > zoom_bottom_border && !vice_raster.blanked; i--)
          {
-            unsigned row   = i * (retrow << (pix_bytes >> 2));
-            unsigned pad   = 8;
-            unsigned col_x = row + (ZOOM_LEFT_BORDER + pad) * (pix_bytes >> 1);
-            unsigned color = retro_bmp[col_x];
-            unsigned found = 0;
-
-            for (j = ZOOM_LEFT_BORDER + pad; j < retrow - ZOOM_LEFT_BORDER - pad; j++)
+            if (zoom_scan_row(i, color_diff))
             {
-               unsigned pixel = row + j * (pix_bytes >> 1);
-
-               if (abs(retro_bmp[pixel] - color) > color_diff)
-                  found++;
-
-               if (found && retro_bmp[pixel] == color)
-               {
 #if 0
-                  printf("%s: LAST %3d %3d, %3d %d\n", __func__, i, j, found, color);
+               printf("%s: LAST %3d\n", __func__, i);
 #endif
-                  vice_raster.last_line = i + 1;
+               vice_raster.last_line = i + 1;
+               if (vice_raster.last_line > ZOOM_TOP_BORDER + ZOOM_HEIGHT_MAX)
                   break;
-               }
             }
-
-            if (vice_raster.last_line > ZOOM_TOP_BORDER + ZOOM_HEIGHT_MAX)
-               break;
          }
 
          /* Align the resulting screen height to even number */
@@ -287,6 +521,10 @@ int video_init()
 
 void video_shutdown()
 {
+   free(frame_prev);
+   frame_prev       = NULL;
+   frame_prev_alloc = 0;
+   retro_frame_force_dirty = true;
 }
 
 int video_arch_resources_init()
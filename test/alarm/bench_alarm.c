@@ -0,0 +1,460 @@
+/* Alarm dispatch benchmark
+ *
+ * Builds vice/src/alarm.c on its own and drives alarm contexts the way the
+ * CPU loops do: advance to the next pending clock, dispatch, and let the
+ * callback set the alarm again. Half of the alarms also move another alarm
+ * of their context around or unset it, like the chips rescheduling each
+ * other. Each argument is one machine setup, the number of pending alarms
+ * of the main CPU context followed by those of each drive context:
+ *
+ *   bench_alarm 9 9+4 9+4+4+4+4
+ *
+ * Every setup runs on the heap of alarm.c and on the linear scan it
+ * replaced, and both have to dispatch the alarms in the same order.
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "alarm.h"
+#include "lib.h"
+#include "log.h"
+
+#define BENCH_MIN_SECONDS   1.0
+#define BENCH_BATCH         100000
+
+/* Dispatches compared between the heap and the linear scan */
+#define BENCH_ORDER_CHECK   1000000
+
+/* Main CPU and up to four drives */
+#define BENCH_MAX_CONTEXTS  5
+
+/* Pull the clock back like the clk guard does, CLOCK is only 32 bits */
+#define BENCH_CLK_GUARD     0x40000000
+
+/* The pending alarm array as it was before the heap: the next alarm is
+   found by scanning all of them whenever the earliest one changes. */
+struct linear_alarm_s;
+
+typedef struct linear_pending_s {
+    struct linear_alarm_s *alarm;
+    CLOCK clk;
+} linear_pending_t;
+
+typedef struct linear_context_s {
+    linear_pending_t pending_alarms[ALARM_CONTEXT_MAX_PENDING_ALARMS];
+    unsigned int num_pending_alarms;
+    CLOCK next_pending_alarm_clk;
+    int next_pending_alarm_idx;
+} linear_context_t;
+
+typedef struct linear_alarm_s {
+    linear_context_t *context;
+    alarm_callback_t callback;
+    void *data;
+    int pending_idx;
+} linear_alarm_t;
+
+typedef struct bench_context_s {
+    alarm_context_t *heap;
+    alarm_t *heap_alarms[ALARM_CONTEXT_MAX_PENDING_ALARMS];
+    linear_context_t linear;
+    linear_alarm_t linear_alarms[ALARM_CONTEXT_MAX_PENDING_ALARMS];
+    CLOCK periods[ALARM_CONTEXT_MAX_PENDING_ALARMS];
+    unsigned int num_alarms;
+} bench_context_t;
+
+static bench_context_t contexts[BENCH_MAX_CONTEXTS];
+static unsigned int num_contexts;
+static int bench_linear;
+
+static CLOCK bench_clk;
+static unsigned int bench_seed;
+
+/* Minimal lib and log for alarm.c, the core ones pull in the whole tree */
+void *lib_malloc(size_t size)
+{
+    void *p = malloc(size);
+
+    if (p == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+void lib_free(void *ptr)
+{
+    free(ptr);
+}
+
+char *lib_strdup(const char *str)
+{
+    return strcpy(lib_malloc(strlen(str) + 1), str);
+}
+
+int log_error(log_t log, const char *format, ...)
+{
+    fprintf(stderr, "%s\n", format);
+    exit(1);
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned int bench_rand(void)
+{
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return (bench_seed >> 16) & 0x7fff;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void linear_update_next_pending(linear_context_t *context)
+{
+    CLOCK next_pending_alarm_clk = (CLOCK)~0L;
+    int next_pending_alarm_idx;
+    unsigned int i;
+
+    next_pending_alarm_idx = context->next_pending_alarm_idx;
+
+    for (i = 0; i < context->num_pending_alarms; i++) {
+        CLOCK pending_clk = context->pending_alarms[i].clk;
+
+        if (pending_clk <= next_pending_alarm_clk) {
+            next_pending_alarm_clk = pending_clk;
+            next_pending_alarm_idx = (int)i;
+        }
+    }
+
+    context->next_pending_alarm_clk = next_pending_alarm_clk;
+    context->next_pending_alarm_idx = next_pending_alarm_idx;
+}
+
+static void linear_dispatch(linear_context_t *context, CLOCK cpu_clk)
+{
+    linear_alarm_t *alarm;
+
+    alarm = context->pending_alarms[context->next_pending_alarm_idx].alarm;
+    (alarm->callback)((CLOCK)(cpu_clk - context->next_pending_alarm_clk), alarm->data);
+}
+
+static void linear_set(linear_alarm_t *alarm, CLOCK cpu_clk)
+{
+    linear_context_t *context = alarm->context;
+    int idx = alarm->pending_idx;
+
+    if (idx < 0) {
+        int new_idx = (int)(context->num_pending_alarms);
+
+        context->pending_alarms[new_idx].alarm = alarm;
+        context->pending_alarms[new_idx].clk = cpu_clk;
+        context->num_pending_alarms++;
+
+        if (cpu_clk < context->next_pending_alarm_clk) {
+            context->next_pending_alarm_clk = cpu_clk;
+            context->next_pending_alarm_idx = new_idx;
+        }
+        alarm->pending_idx = new_idx;
+    } else {
+        context->pending_alarms[idx].clk = cpu_clk;
+        if (context->next_pending_alarm_clk > cpu_clk
+            || idx == context->next_pending_alarm_idx) {
+            linear_update_next_pending(context);
+        }
+    }
+}
+
+static void linear_unset(linear_alarm_t *alarm)
+{
+    linear_context_t *context = alarm->context;
+    int idx = alarm->pending_idx;
+
+    if (idx < 0) {
+        return;
+    }
+
+    if (context->num_pending_alarms > 1) {
+        int last = (int)(--context->num_pending_alarms);
+
+        if (last != idx) {
+            context->pending_alarms[idx] = context->pending_alarms[last];
+            context->pending_alarms[idx].alarm->pending_idx = idx;
+        }
+
+        if (context->next_pending_alarm_idx == idx) {
+            linear_update_next_pending(context);
+        } else if (context->next_pending_alarm_idx == last) {
+            context->next_pending_alarm_idx = idx;
+        }
+    } else {
+        context->num_pending_alarms = 0;
+        context->next_pending_alarm_clk = (CLOCK)~0L;
+        context->next_pending_alarm_idx = -1;
+    }
+
+    alarm->pending_idx = -1;
+}
+
+static void linear_time_warp(linear_context_t *context, CLOCK warp_amount)
+{
+    unsigned int i;
+
+    for (i = 0; i < context->num_pending_alarms; i++) {
+        context->pending_alarms[i].clk -= warp_amount;
+    }
+    context->next_pending_alarm_clk -= warp_amount;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void bench_set(bench_context_t *context, unsigned int idx, CLOCK clk)
+{
+    if (bench_linear) {
+        linear_set(&context->linear_alarms[idx], clk);
+    } else {
+        alarm_set(context->heap_alarms[idx], clk);
+    }
+}
+
+static void bench_unset(bench_context_t *context, unsigned int idx)
+{
+    if (bench_linear) {
+        linear_unset(&context->linear_alarms[idx]);
+    } else {
+        alarm_unset(context->heap_alarms[idx]);
+    }
+}
+
+static CLOCK bench_next_pending_clk(bench_context_t *context)
+{
+    if (bench_linear) {
+        return context->linear.next_pending_alarm_clk;
+    }
+    return alarm_context_next_pending_clk(context->heap);
+}
+
+static void bench_alarm_handler(CLOCK offset, void *data)
+{
+    bench_context_t *context = &contexts[(size_t)data >> 16];
+    unsigned int idx = (unsigned int)(size_t)data & 0xffff;
+
+    bench_set(context, idx, bench_clk + context->periods[idx]);
+
+    if (idx & 1) {
+        unsigned int other = bench_rand() % context->num_alarms;
+
+        if (bench_rand() & 1) {
+            bench_set(context, other, bench_clk + 1 + bench_rand() % 64);
+        } else if (other != idx) {
+            bench_unset(context, other);
+            bench_set(context, other, bench_clk + 1 + bench_rand() % 20000);
+        }
+    }
+}
+
+static void bench_setup(const unsigned int *num, unsigned int count)
+{
+    bench_context_t *context;
+    char name[32];
+    unsigned int c, i;
+
+    bench_seed = 1;
+    num_contexts = count;
+    for (c = 0; c < count; c++) {
+        context = &contexts[c];
+        context->num_alarms = num[c];
+        context->heap = NULL;
+        if (!bench_linear) {
+            sprintf(name, "Bench%u", c);
+            context->heap = alarm_context_new(name);
+        }
+        context->linear.num_pending_alarms = 0;
+        context->linear.next_pending_alarm_clk = (CLOCK)~0L;
+        context->linear.next_pending_alarm_idx = -1;
+        for (i = 0; i < num[c]; i++) {
+            void *data = (void *)(size_t)((c << 16) | i);
+
+            if (bench_linear) {
+                context->linear_alarms[i].context = &context->linear;
+                context->linear_alarms[i].callback = bench_alarm_handler;
+                context->linear_alarms[i].data = data;
+                context->linear_alarms[i].pending_idx = -1;
+            } else {
+                sprintf(name, "Bench%u.%u", c, i);
+                context->heap_alarms[i] = alarm_new(context->heap, name, bench_alarm_handler, data);
+            }
+            context->periods[i] = 1 + bench_rand() % 20000;
+            bench_set(context, i, context->periods[i]);
+        }
+    }
+    bench_clk = 0;
+}
+
+static void bench_teardown(void)
+{
+    unsigned int c;
+
+    for (c = 0; c < num_contexts; c++) {
+        if (contexts[c].heap != NULL) {
+            alarm_context_destroy(contexts[c].heap);
+        }
+    }
+}
+
+/* Dispatch the next alarm of the context due first, like the drives
+   catching up with the main CPU; returns the alarm dispatched */
+static unsigned int bench_step(void)
+{
+    bench_context_t *context = &contexts[0];
+    unsigned int c;
+    CLOCK next_clk;
+
+    for (c = 1; c < num_contexts; c++) {
+        if (bench_next_pending_clk(&contexts[c]) < bench_next_pending_clk(context)) {
+            context = &contexts[c];
+        }
+    }
+
+    next_clk = bench_next_pending_clk(context);
+    if (next_clk < bench_clk) {
+        fprintf(stderr, "Alarm dispatched out of order at %lu\n", (unsigned long)next_clk);
+        exit(1);
+    }
+    bench_clk = next_clk;
+
+    if (bench_linear) {
+        linear_alarm_t *alarm = context->linear.pending_alarms[context->linear.next_pending_alarm_idx].alarm;
+
+        linear_dispatch(&context->linear, bench_clk);
+        return (unsigned int)(size_t)alarm->data;
+    } else {
+        alarm_t *alarm = context->heap->next_pending_alarm;
+
+        alarm_context_dispatch(context->heap, bench_clk);
+        return (unsigned int)(size_t)alarm->data;
+    }
+}
+
+static void bench_clk_guard(void)
+{
+    unsigned int c;
+
+    if (bench_clk <= BENCH_CLK_GUARD) {
+        return;
+    }
+    for (c = 0; c < num_contexts; c++) {
+        if (bench_linear) {
+            linear_time_warp(&contexts[c].linear, BENCH_CLK_GUARD);
+        } else {
+            alarm_context_time_warp(contexts[c].heap, BENCH_CLK_GUARD, -1);
+        }
+    }
+    bench_clk -= BENCH_CLK_GUARD;
+}
+
+/* Hash of the alarms dispatched and their clocks */
+static uint32_t bench_order(const unsigned int *num, unsigned int count)
+{
+    uint32_t hash = 2166136261u;
+    unsigned long i;
+
+    bench_setup(num, count);
+    for (i = 0; i < BENCH_ORDER_CHECK; i++) {
+        unsigned int data = bench_step();
+
+        hash = (hash ^ data) * 16777619u;
+        hash = (hash ^ (uint32_t)bench_clk) * 16777619u;
+        bench_clk_guard();
+    }
+    bench_teardown();
+    return hash;
+}
+
+static double bench_rate(const unsigned int *num, unsigned int count)
+{
+    double start;
+    double elapsed;
+    unsigned long dispatched;
+    unsigned int i;
+
+    bench_setup(num, count);
+    dispatched = 0;
+    start = now_seconds();
+    do {
+        for (i = 0; i < BENCH_BATCH; i++) {
+            bench_step();
+        }
+        dispatched += BENCH_BATCH;
+        bench_clk_guard();
+    } while ((elapsed = now_seconds() - start) < BENCH_MIN_SECONDS);
+    bench_teardown();
+
+    return elapsed * 1e9 / dispatched;
+}
+
+static int bench_run(const char *setup, const unsigned int *num, unsigned int count)
+{
+    uint32_t heap_order, linear_order;
+    double heap_ns, linear_ns;
+
+    bench_linear = 0;
+    heap_order = bench_order(num, count);
+    heap_ns = bench_rate(num, count);
+    bench_linear = 1;
+    linear_order = bench_order(num, count);
+    linear_ns = bench_rate(num, count);
+
+    printf("%-16s heap %6.1f ns  linear %6.1f ns  %5.2fx\n",
+           setup, heap_ns, linear_ns, linear_ns / heap_ns);
+
+    if (heap_order != linear_order) {
+        fprintf(stderr, "%s: heap dispatch order differs from the linear scan\n", setup);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int num[BENCH_MAX_CONTEXTS];
+    unsigned int count;
+    const char *p;
+    char *end;
+    int i;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <main CPU pending alarms>[+<drive pending alarms>...] ...\n", argv[0]);
+        return 1;
+    }
+
+    for (i = 1; i < argc; i++) {
+        count = 0;
+        p = argv[i];
+        do {
+            unsigned long n = strtoul(p, &end, 10);
+
+            if (end == p || n < 1 || n > ALARM_CONTEXT_MAX_PENDING_ALARMS
+                || count == BENCH_MAX_CONTEXTS || (*end != '\0' && *end != '+')) {
+                fprintf(stderr, "Bad setup `%s': 1 to %d contexts of 1..%d pending alarms\n",
+                        argv[i], BENCH_MAX_CONTEXTS, ALARM_CONTEXT_MAX_PENDING_ALARMS);
+                return 1;
+            }
+            num[count++] = (unsigned int)n;
+            p = end + 1;
+        } while (*end == '+');
+
+        if (bench_run(argv[i], num, count) < 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
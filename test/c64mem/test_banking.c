@@ -0,0 +1,451 @@
+/* C64 memory banking test
+ *
+ * Loads a built x64 or x64sc core as a minimal frontend and runs a small
+ * machine code program that walks all eight $01 memory configurations. For
+ * each one it
+ *
+ *   1. fills the test pages with a pattern while all RAM is banked in,
+ *   2. switches to the configuration, copies the test pages out and writes
+ *      the inverted pattern to them,
+ *   3. banks all RAM in again and copies the test pages out once more.
+ *
+ * The first copy shows what the CPU reads under the configuration, the second
+ * one where its writes went. Both are checked against the PLA mapping without
+ * a cartridge: RAM pages must return the pattern, BASIC, KERNAL and character
+ * ROM pages their known bytes, and writes must always reach the RAM below,
+ * except for the I/O page which is neither read nor written.
+ *
+ *   test_banking ./vice_x64sc_libretro.so
+ */
+
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libretro.h>
+
+#define BANKING_BOOT_FRAMES 300
+#define BANKING_MAX_FRAMES  600
+
+#define BANKING_MAX_OPTIONS 1024
+
+#define PROGRAM_ADDR        0xc000
+#define DONE_ADDR           0xc207
+#define DONE_VALUE          0xa5
+#define READ_COPY_ADDR      0x4000
+#define WRITE_COPY_ADDR     0x6800
+
+#define NUM_CONFIGS         8
+#define NUM_PAGES           5
+
+enum {
+   SRC_RAM,
+   SRC_BASIC,
+   SRC_KERNAL,
+   SRC_CHARGEN,
+   SRC_IO
+};
+
+static const char *src_names[] = { "RAM", "BASIC", "KERNAL", "CHARGEN", "I/O" };
+
+static const uint8_t test_pages[NUM_PAGES] = { 0xa0, 0xbf, 0xd0, 0xe0, 0xff };
+
+/* Assembled at $c000. Variables live at $c200-$c207 (configuration,
+   pattern mask, I/O visible, skip I/O page, invert, read and write copy
+   pages, done flag), $fb/$fc and $fd/$fe are the source and destination
+   pointers. */
+static const uint8_t program[] = {
+   /* start: */
+   0x78,                            /* c000  sei */
+   0xa9, 0x00,                      /* c001  lda #$00 */
+   0x85, 0xfb,                      /* c003  sta $fb */
+   0x85, 0xfd,                      /* c005  sta $fd */
+   0x8d, 0x00, 0xc2,                /* c007  sta $c200 */
+   0xa9, 0x40,                      /* c00a  lda #$40 */
+   0x8d, 0x05, 0xc2,                /* c00c  sta $c205 */
+   0xa9, 0x68,                      /* c00f  lda #$68 */
+   0x8d, 0x06, 0xc2,                /* c011  sta $c206 */
+   /* cfgloop: */
+   0xad, 0x00, 0xc2,                /* c014  lda $c200 */
+   0x0a,                            /* c017  asl */
+   0x0a,                            /* c018  asl */
+   0x0a,                            /* c019  asl */
+   0x0a,                            /* c01a  asl */
+   0x0d, 0x00, 0xc2,                /* c01b  ora $c200 */
+   0x8d, 0x01, 0xc2,                /* c01e  sta $c201 */
+   0xa9, 0x00,                      /* c021  lda #$00 */
+   0x8d, 0x02, 0xc2,                /* c023  sta $c202 */
+   0xad, 0x00, 0xc2,                /* c026  lda $c200 */
+   0x29, 0x03,                      /* c029  and #$03 */
+   0xf0, 0x0a,                      /* c02b  beq noio */
+   0xad, 0x00, 0xc2,                /* c02d  lda $c200 */
+   0x29, 0x04,                      /* c030  and #$04 */
+   0xf0, 0x03,                      /* c032  beq noio */
+   0xee, 0x02, 0xc2,                /* c034  inc $c202 */
+   /* noio: */
+   0xa9, 0x30,                      /* c037  lda #$30 */
+   0x85, 0x01,                      /* c039  sta $01 */
+   0xa9, 0x00,                      /* c03b  lda #$00 */
+   0x8d, 0x03, 0xc2,                /* c03d  sta $c203 */
+   0x8d, 0x04, 0xc2,                /* c040  sta $c204 */
+   0x20, 0x8b, 0xc0,                /* c043  jsr fill */
+   0xad, 0x00, 0xc2,                /* c046  lda $c200 */
+   0x09, 0x30,                      /* c049  ora #$30 */
+   0x85, 0x01,                      /* c04b  sta $01 */
+   0xad, 0x02, 0xc2,                /* c04d  lda $c202 */
+   0x8d, 0x03, 0xc2,                /* c050  sta $c203 */
+   0xad, 0x05, 0xc2,                /* c053  lda $c205 */
+   0x20, 0xb3, 0xc0,                /* c056  jsr copy */
+   0x8d, 0x05, 0xc2,                /* c059  sta $c205 */
+   0xa9, 0xff,                      /* c05c  lda #$ff */
+   0x8d, 0x04, 0xc2,                /* c05e  sta $c204 */
+   0x20, 0x8b, 0xc0,                /* c061  jsr fill */
+   0xa9, 0x30,                      /* c064  lda #$30 */
+   0x85, 0x01,                      /* c066  sta $01 */
+   0xa9, 0x00,                      /* c068  lda #$00 */
+   0x8d, 0x03, 0xc2,                /* c06a  sta $c203 */
+   0xad, 0x06, 0xc2,                /* c06d  lda $c206 */
+   0x20, 0xb3, 0xc0,                /* c070  jsr copy */
+   0x8d, 0x06, 0xc2,                /* c073  sta $c206 */
+   0xee, 0x00, 0xc2,                /* c076  inc $c200 */
+   0xad, 0x00, 0xc2,                /* c079  lda $c200 */
+   0xc9, 0x08,                      /* c07c  cmp #$08 */
+   0xd0, 0x94,                      /* c07e  bne cfgloop */
+   0xa9, 0x37,                      /* c080  lda #$37 */
+   0x85, 0x01,                      /* c082  sta $01 */
+   0xa9, 0xa5,                      /* c084  lda #$a5 */
+   0x8d, 0x07, 0xc2,                /* c086  sta $c207 */
+   0x58,                            /* c089  cli */
+   0x60,                            /* c08a  rts */
+   /* fill: */
+   0xa2, 0x00,                      /* c08b  ldx #$00 */
+   /* floop: */
+   0xbd, 0xda, 0xc0,                /* c08d  lda pages,x */
+   0x85, 0xfc,                      /* c090  sta $fc */
+   0xad, 0x03, 0xc2,                /* c092  lda $c203 */
+   0xf0, 0x06,                      /* c095  beq fdo */
+   0xa5, 0xfc,                      /* c097  lda $fc */
+   0xc9, 0xd0,                      /* c099  cmp #$d0 */
+   0xf0, 0x10,                      /* c09b  beq fnext */
+   /* fdo: */
+   0xa0, 0x00,                      /* c09d  ldy #$00 */
+   /* fbyte: */
+   0x98,                            /* c09f  tya */
+   0x45, 0xfc,                      /* c0a0  eor $fc */
+   0x4d, 0x01, 0xc2,                /* c0a2  eor $c201 */
+   0x4d, 0x04, 0xc2,                /* c0a5  eor $c204 */
+   0x91, 0xfb,                      /* c0a8  sta ($fb),y */
+   0xc8,                            /* c0aa  iny */
+   0xd0, 0xf2,                      /* c0ab  bne fbyte */
+   /* fnext: */
+   0xe8,                            /* c0ad  inx */
+   0xe0, 0x05,                      /* c0ae  cpx #$05 */
+   0xd0, 0xdb,                      /* c0b0  bne floop */
+   0x60,                            /* c0b2  rts */
+   /* copy: */
+   0x85, 0xfe,                      /* c0b3  sta $fe */
+   0xa2, 0x00,                      /* c0b5  ldx #$00 */
+   /* cloop: */
+   0xbd, 0xda, 0xc0,                /* c0b7  lda pages,x */
+   0x85, 0xfc,                      /* c0ba  sta $fc */
+   0xad, 0x03, 0xc2,                /* c0bc  lda $c203 */
+   0xf0, 0x06,                      /* c0bf  beq cdo */
+   0xa5, 0xfc,                      /* c0c1  lda $fc */
+   0xc9, 0xd0,                      /* c0c3  cmp #$d0 */
+   0xf0, 0x09,                      /* c0c5  beq cnext */
+   /* cdo: */
+   0xa0, 0x00,                      /* c0c7  ldy #$00 */
+   /* cbyte: */
+   0xb1, 0xfb,                      /* c0c9  lda ($fb),y */
+   0x91, 0xfd,                      /* c0cb  sta ($fd),y */
+   0xc8,                            /* c0cd  iny */
+   0xd0, 0xf9,                      /* c0ce  bne cbyte */
+   /* cnext: */
+   0xe6, 0xfe,                      /* c0d0  inc $fe */
+   0xe8,                            /* c0d2  inx */
+   0xe0, 0x05,                      /* c0d3  cpx #$05 */
+   0xd0, 0xe0,                      /* c0d5  bne cloop */
+   0xa5, 0xfe,                      /* c0d7  lda $fe */
+   0x60,                            /* c0d9  rts */
+   /* pages: */
+   0xa0, 0xbf, 0xd0, 0xe0, 0xff,    /* c0da  .byte $a0,$bf,$d0,$e0,$ff */
+};
+
+/* Known ROM bytes: BASIC start vectors and "CBMBASIC", the "@" glyph and the
+   NMI, RESET and IRQ vectors */
+static const uint8_t basic_a000[] = { 0x94, 0xe3, 0x7b, 0xe3, 'C', 'B', 'M', 'B', 'A', 'S', 'I', 'C' };
+static const uint8_t chargen_d000[] = { 0x3c, 0x66, 0x6e, 0x6e, 0x60, 0x62, 0x3c, 0x00 };
+static const uint8_t kernal_fffa[] = { 0x43, 0xfe, 0xe2, 0xfc, 0x48, 0xff };
+
+/* Options from the command line first, then the core defaults */
+static const char *opt_keys[BANKING_MAX_OPTIONS];
+static const char *opt_values[BANKING_MAX_OPTIONS];
+static int opt_count;
+
+/* Not the tree root, the core would take the "vice" source dir for its own */
+static const char *system_dir = "/tmp";
+
+static void log_cb(enum retro_log_level level, const char *fmt, ...)
+{
+   va_list va;
+   if (level < RETRO_LOG_WARN)
+      return;
+   va_start(va, fmt);
+   vfprintf(stderr, fmt, va);
+   va_end(va);
+}
+
+static bool environ_cb(unsigned cmd, void *data)
+{
+   int i;
+
+   switch (cmd)
+   {
+      case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+         ((struct retro_log_callback *)data)->log = log_cb;
+         return true;
+      case RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY:
+      case RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY:
+         *(const char **)data = system_dir;
+         return true;
+      case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+         return true;
+      case RETRO_ENVIRONMENT_GET_VARIABLE:
+         {
+            struct retro_variable *var = (struct retro_variable *)data;
+            for (i = 0; i < opt_count; i++)
+            {
+               if (!strcmp(opt_keys[i], var->key))
+               {
+                  var->value = opt_values[i];
+                  return true;
+               }
+            }
+         }
+         return false;
+      case RETRO_ENVIRONMENT_GET_CORE_OPTIONS_VERSION:
+         /* Legacy variables carry the defaults in a parseable form */
+         *(unsigned *)data = 0;
+         return true;
+      case RETRO_ENVIRONMENT_SET_VARIABLES:
+         {
+            const struct retro_variable *var = (const struct retro_variable *)data;
+            for (; var->key && opt_count < BANKING_MAX_OPTIONS; var++)
+            {
+               /* "Description; default|other|..." */
+               const char *values = strstr(var->value, "; ");
+               char *value = strdup(values ? values + 2 : "");
+               char *sep = strchr(value, '|');
+               if (sep)
+                  *sep = '\0';
+               opt_keys[opt_count]     = strdup(var->key);
+               opt_values[opt_count++] = value;
+            }
+         }
+         return true;
+      case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
+         *(bool *)data = false;
+         return true;
+      default:
+         break;
+   }
+   return false;
+}
+
+static void video_cb(const void *data, unsigned width, unsigned height, size_t pitch) {}
+static void audio_cb(int16_t left, int16_t right) {}
+static size_t audio_batch_cb(const int16_t *data, size_t frames) { return frames; }
+static void input_poll_cb(void) {}
+static int16_t input_state_cb(unsigned port, unsigned device, unsigned index, unsigned id) { return 0; }
+
+#define CORE_SYMBOL(handle, name) \
+   typeof(&name) p_##name = (typeof(&name))dlsym(handle, #name)
+
+/* What the CPU sees at a page for the LORAM/HIRAM/CHAREN bits of $01 */
+static int page_source(int config, uint8_t page)
+{
+   int loram  = config & 1;
+   int hiram  = config & 2;
+   int charen = config & 4;
+
+   if (page >= 0xa0 && page <= 0xbf)
+      return (loram && hiram) ? SRC_BASIC : SRC_RAM;
+   if (page >= 0xd0 && page <= 0xdf)
+   {
+      if (!loram && !hiram)
+         return SRC_RAM;
+      return charen ? SRC_IO : SRC_CHARGEN;
+   }
+   if (page >= 0xe0)
+      return hiram ? SRC_KERNAL : SRC_RAM;
+   return SRC_RAM;
+}
+
+static uint8_t pattern(int config, uint8_t page, int offset)
+{
+   return (uint8_t)(offset ^ page ^ (config * 0x11));
+}
+
+static int check_bytes(const uint8_t *data, const uint8_t *expected, size_t size)
+{
+   return !memcmp(data, expected, size);
+}
+
+/* ROM pages must not read back the pattern and must match across configs */
+static int check_rom_page(const uint8_t *data, int config, uint8_t page, const uint8_t **seen)
+{
+   int offset;
+   int matches = 0;
+
+   for (offset = 0; offset < 256; offset++)
+      if (data[offset] == pattern(config, page, offset))
+         matches++;
+   if (matches == 256)
+      return 0;
+
+   if (*seen)
+      return !memcmp(data, *seen, 256);
+   *seen = data;
+
+   if (page == 0xa0)
+      return check_bytes(data, basic_a000, sizeof(basic_a000));
+   if (page == 0xd0)
+      return check_bytes(data, chargen_d000, sizeof(chargen_d000));
+   if (page == 0xff)
+      return check_bytes(data + 0xfa, kernal_fffa, sizeof(kernal_fffa));
+   return 1;
+}
+
+int main(int argc, char *argv[])
+{
+   const uint8_t *rom_seen[NUM_PAGES] = { NULL };
+   uint8_t *ram;
+   int failed = 0;
+   int config;
+   int i;
+
+   if (argc < 2)
+   {
+      fprintf(stderr, "Usage: %s <core> [option=value ...]\n", argv[0]);
+      return 1;
+   }
+
+   for (i = 2; i < argc && opt_count < BANKING_MAX_OPTIONS; i++)
+   {
+      char *eq = strchr(argv[i], '=');
+      if (!eq)
+         continue;
+      *eq = '\0';
+      opt_keys[opt_count]     = argv[i];
+      opt_values[opt_count++] = eq + 1;
+   }
+   if (getenv("BENCH_SYSTEM_DIR"))
+      system_dir = getenv("BENCH_SYSTEM_DIR");
+
+   void *core = dlopen(argv[1], RTLD_NOW | RTLD_LOCAL);
+   if (!core)
+   {
+      fprintf(stderr, "%s\n", dlerror());
+      return 1;
+   }
+
+   CORE_SYMBOL(core, retro_set_environment);
+   CORE_SYMBOL(core, retro_set_video_refresh);
+   CORE_SYMBOL(core, retro_set_audio_sample);
+   CORE_SYMBOL(core, retro_set_audio_sample_batch);
+   CORE_SYMBOL(core, retro_set_input_poll);
+   CORE_SYMBOL(core, retro_set_input_state);
+   CORE_SYMBOL(core, retro_init);
+   CORE_SYMBOL(core, retro_deinit);
+   CORE_SYMBOL(core, retro_load_game);
+   CORE_SYMBOL(core, retro_unload_game);
+   CORE_SYMBOL(core, retro_run);
+   CORE_SYMBOL(core, retro_get_memory_data);
+   CORE_SYMBOL(core, retro_get_memory_size);
+
+   p_retro_set_environment(environ_cb);
+   p_retro_set_video_refresh(video_cb);
+   p_retro_set_audio_sample(audio_cb);
+   p_retro_set_audio_sample_batch(audio_batch_cb);
+   p_retro_set_input_poll(input_poll_cb);
+   p_retro_set_input_state(input_state_cb);
+   p_retro_init();
+   if (!p_retro_load_game(NULL))
+   {
+      fprintf(stderr, "Failed to start the core\n");
+      return 1;
+   }
+
+   ram = (uint8_t *)p_retro_get_memory_data(RETRO_MEMORY_SYSTEM_RAM);
+   if (!ram || p_retro_get_memory_size(RETRO_MEMORY_SYSTEM_RAM) < 0x10000)
+   {
+      fprintf(stderr, "No 64K system RAM\n");
+      return 1;
+   }
+
+   for (i = 0; i < BANKING_BOOT_FRAMES; i++)
+      p_retro_run();
+
+   /* Start the program from the READY prompt through the keyboard buffer */
+   memcpy(ram + PROGRAM_ADDR, program, sizeof(program));
+   ram[DONE_ADDR] = 0;
+   memcpy(ram + 0x0277, "SYS49152\r", 9);
+   ram[0xc6] = 9;
+
+   for (i = 0; i < BANKING_MAX_FRAMES && ram[DONE_ADDR] != DONE_VALUE; i++)
+      p_retro_run();
+   if (ram[DONE_ADDR] != DONE_VALUE)
+   {
+      fprintf(stderr, "The test program did not finish\n");
+      return 1;
+   }
+
+   for (config = 0; config < NUM_CONFIGS; config++)
+   {
+      int page_index;
+
+      printf("$01=$%02x", 0x30 | config);
+      for (page_index = 0; page_index < NUM_PAGES; page_index++)
+      {
+         uint8_t page     = test_pages[page_index];
+         int src          = page_source(config, page);
+         int copy         = (config * NUM_PAGES + page_index) * 256;
+         const uint8_t *r = ram + READ_COPY_ADDR + copy;
+         const uint8_t *w = ram + WRITE_COPY_ADDR + copy;
+         int ok = 1;
+         int offset;
+
+         if (src == SRC_RAM)
+         {
+            for (offset = 0; offset < 256; offset++)
+               if (r[offset] != pattern(config, page, offset))
+                  ok = 0;
+         }
+         else if (src != SRC_IO)
+            ok = check_rom_page(r, config, page, &rom_seen[page_index]);
+
+         /* writes reach the RAM below ROM, the I/O page was not written */
+         for (offset = 0; offset < 256; offset++)
+         {
+            uint8_t expected = pattern(config, page, offset);
+            if (src != SRC_IO)
+               expected ^= 0xff;
+            if (w[offset] != expected)
+               ok = 0;
+         }
+
+         printf("  %02x00 %-7s %s", page, src_names[src], ok ? "ok" : "FAIL");
+         if (!ok)
+            failed = 1;
+      }
+      printf("\n");
+   }
+
+   p_retro_unload_game();
+   p_retro_deinit();
+   return failed;
+}
@@ -0,0 +1,122 @@
+/* FIR convolution kernel test
+ *
+ * Checks every vector kernel of resid/convolve.h this build and CPU have
+ * against convolve_scalar, bit for bit. Lengths cover the vector tails,
+ * the buffers are misaligned on purpose and the input includes -32768
+ * products that wrap the 32 bit sum.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "convolve.h"
+
+#define TEST_MAX_LENGTH   1024
+#define TEST_PATTERNS     4
+
+static short a_buf[TEST_MAX_LENGTH + 16];
+static short b_buf[TEST_MAX_LENGTH + 16];
+static unsigned int test_seed = 1;
+
+struct test_kernel {
+  const char* name;
+  convolve_func_t func;
+};
+
+static short test_rand(void)
+{
+  test_seed = test_seed * 1103515245 + 12345;
+  return (short)(test_seed >> 16);
+}
+
+static void test_fill(short* buf, int n, int pattern)
+{
+  for (int i = 0; i < n; i++) {
+    switch (pattern) {
+    case 0:
+      buf[i] = test_rand();
+      break;
+    case 1:
+      buf[i] = -32768;
+      break;
+    case 2:
+      buf[i] = (i & 1) ? 32767 : -32768;
+      break;
+    default:
+      /* Small values like the FIR tails */
+      buf[i] = test_rand() >> 12;
+      break;
+    }
+  }
+}
+
+/* The reference, in unsigned so the wrap is defined */
+static int test_reference(const short* a, const short* b, int n)
+{
+  unsigned int v = 0;
+  for (int i = 0; i < n; i++) {
+    v += (unsigned int)(a[i]*b[i]);
+  }
+  return (int)v;
+}
+
+int main(void)
+{
+  struct test_kernel kernels[8];
+  int num_kernels = 0;
+  int failed = 0;
+
+  kernels[num_kernels].name = "scalar";
+  kernels[num_kernels++].func = convolve_scalar;
+#ifdef CONVOLVE_SSE2
+  kernels[num_kernels].name = "sse2";
+  kernels[num_kernels++].func = convolve_sse2;
+#endif
+#ifdef CONVOLVE_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kernels[num_kernels].name = "avx2";
+    kernels[num_kernels++].func = convolve_avx2;
+  }
+#endif
+#ifdef CONVOLVE_NEON
+  kernels[num_kernels].name = "neon";
+  kernels[num_kernels++].func = convolve_neon;
+#endif
+  kernels[num_kernels].name = "selected";
+  kernels[num_kernels++].func = convolve_select();
+
+  for (int k = 0; k < num_kernels; k++) {
+    int mismatches = 0;
+
+    for (int pattern = 0; pattern < TEST_PATTERNS; pattern++) {
+      for (int n = 0; n <= TEST_MAX_LENGTH; n += (n < 64) ? 1 : 7) {
+        for (int offset = 0; offset < 3; offset++) {
+          const short* a = a_buf + offset;
+          const short* b = b_buf + 2 * offset;
+          int expected, result;
+
+          test_fill(a_buf, TEST_MAX_LENGTH + 16, pattern);
+          test_fill(b_buf, TEST_MAX_LENGTH + 16, pattern == 1 ? 1 : 0);
+
+          expected = test_reference(a, b, n);
+          result = kernels[k].func(a, b, n);
+          if (result != expected) {
+            if (!mismatches) {
+              fprintf(stderr, "%s: pattern %d length %d offset %d: %d, expected %d\n",
+                      kernels[k].name, pattern, n, offset, result, expected);
+            }
+            mismatches++;
+          }
+        }
+      }
+    }
+
+    printf("%-8s %s\n", kernels[k].name, mismatches ? "FAILED" : "ok");
+    if (mismatches) {
+      failed = 1;
+    }
+  }
+
+  return failed;
+}
@@ -0,0 +1,225 @@
+/* Snapshot throughput benchmark
+ *
+ * Loads a built core as a minimal frontend, runs it for a while and then
+ * measures retro_serialize() and retro_unserialize() in MB/s. Core options
+ * are given as key=value arguments, so each machine model is one run:
+ *
+ *   bench_snapshot ./vice_x64_libretro.so vice_c64_model="C64C PAL"
+ */
+
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libretro.h>
+
+#define BENCH_WARMUP_FRAMES 300
+#define BENCH_MIN_SECONDS   1.0
+
+#define BENCH_MAX_OPTIONS   1024
+
+/* Options from the command line first, then the core defaults */
+static const char *opt_keys[BENCH_MAX_OPTIONS];
+static const char *opt_values[BENCH_MAX_OPTIONS];
+static int opt_count;
+static int opt_user_count;
+
+/* Not the tree root, the core would take the "vice" source dir for its own */
+static const char *system_dir = "/tmp";
+
+static double now_seconds(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void log_cb(enum retro_log_level level, const char *fmt, ...)
+{
+   va_list va;
+   if (level < RETRO_LOG_WARN)
+      return;
+   va_start(va, fmt);
+   vfprintf(stderr, fmt, va);
+   va_end(va);
+}
+
+static bool environ_cb(unsigned cmd, void *data)
+{
+   int i;
+
+   switch (cmd)
+   {
+      case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+         ((struct retro_log_callback *)data)->log = log_cb;
+         return true;
+      case RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY:
+      case RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY:
+         *(const char **)data = system_dir;
+         return true;
+      case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+         return true;
+      case RETRO_ENVIRONMENT_GET_VARIABLE:
+         {
+            struct retro_variable *var = (struct retro_variable *)data;
+            for (i = 0; i < opt_count; i++)
+            {
+               if (!strcmp(opt_keys[i], var->key))
+               {
+                  var->value = opt_values[i];
+                  return true;
+               }
+            }
+         }
+         return false;
+      case RETRO_ENVIRONMENT_GET_CORE_OPTIONS_VERSION:
+         /* Legacy variables carry the defaults in a parseable form */
+         *(unsigned *)data = 0;
+         return true;
+      case RETRO_ENVIRONMENT_SET_VARIABLES:
+         {
+            const struct retro_variable *var = (const struct retro_variable *)data;
+            for (; var->key && opt_count < BENCH_MAX_OPTIONS; var++)
+            {
+               /* "Description; default|other|..." */
+               const char *values = strstr(var->value, "; ");
+               char *value = strdup(values ? values + 2 : "");
+               char *sep = strchr(value, '|');
+               if (sep)
+                  *sep = '\0';
+               opt_keys[opt_count]     = strdup(var->key);
+               opt_values[opt_count++] = value;
+            }
+         }
+         return true;
+      case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
+         *(bool *)data = false;
+         return true;
+      default:
+         break;
+   }
+   return false;
+}
+
+static void video_cb(const void *data, unsigned width, unsigned height, size_t pitch) {}
+static void audio_cb(int16_t left, int16_t right) {}
+static size_t audio_batch_cb(const int16_t *data, size_t frames) { return frames; }
+static void input_poll_cb(void) {}
+static int16_t input_state_cb(unsigned port, unsigned device, unsigned index, unsigned id) { return 0; }
+
+#define CORE_SYMBOL(handle, name) \
+   typeof(&name) p_##name = (typeof(&name))dlsym(handle, #name)
+
+int main(int argc, char *argv[])
+{
+   void *core;
+   void *state;
+   size_t size;
+   double start;
+   double elapsed;
+   unsigned count;
+   int i;
+
+   if (argc < 2)
+   {
+      fprintf(stderr, "Usage: %s <core> [option=value ...]\n", argv[0]);
+      return 1;
+   }
+
+   for (i = 2; i < argc && opt_count < BENCH_MAX_OPTIONS; i++)
+   {
+      char *eq = strchr(argv[i], '=');
+      if (!eq)
+         continue;
+      *eq = '\0';
+      opt_keys[opt_count]     = argv[i];
+      opt_values[opt_count++] = eq + 1;
+   }
+   opt_user_count = opt_count;
+   if (getenv("BENCH_SYSTEM_DIR"))
+      system_dir = getenv("BENCH_SYSTEM_DIR");
+
+   core = dlopen(argv[1], RTLD_NOW | RTLD_LOCAL);
+   if (!core)
+   {
+      fprintf(stderr, "%s\n", dlerror());
+      return 1;
+   }
+
+   CORE_SYMBOL(core, retro_set_environment);
+   CORE_SYMBOL(core, retro_set_video_refresh);
+   CORE_SYMBOL(core, retro_set_audio_sample);
+   CORE_SYMBOL(core, retro_set_audio_sample_batch);
+   CORE_SYMBOL(core, retro_set_input_poll);
+   CORE_SYMBOL(core, retro_set_input_state);
+   CORE_SYMBOL(core, retro_init);
+   CORE_SYMBOL(core, retro_deinit);
+   CORE_SYMBOL(core, retro_load_game);
+   CORE_SYMBOL(core, retro_unload_game);
+   CORE_SYMBOL(core, retro_run);
+   CORE_SYMBOL(core, retro_serialize_size);
+   CORE_SYMBOL(core, retro_serialize);
+   CORE_SYMBOL(core, retro_unserialize);
+
+   p_retro_set_environment(environ_cb);
+   p_retro_set_video_refresh(video_cb);
+   p_retro_set_audio_sample(audio_cb);
+   p_retro_set_audio_sample_batch(audio_batch_cb);
+   p_retro_set_input_poll(input_poll_cb);
+   p_retro_set_input_state(input_state_cb);
+   p_retro_init();
+   if (!p_retro_load_game(NULL))
+   {
+      fprintf(stderr, "Failed to start the core\n");
+      return 1;
+   }
+
+   for (i = 0; i < BENCH_WARMUP_FRAMES; i++)
+      p_retro_run();
+
+   size  = p_retro_serialize_size();
+   state = malloc(size);
+   if (!size || !state || !p_retro_serialize(state, size))
+   {
+      fprintf(stderr, "Failed to serialize\n");
+      return 1;
+   }
+
+   for (i = 0; i < opt_user_count; i++)
+      printf("%s=%s ", opt_keys[i], opt_values[i]);
+   printf("(%u bytes)\n", (unsigned)size);
+
+   count = 0;
+   start = now_seconds();
+   do
+   {
+      p_retro_serialize(state, size);
+      count++;
+   } while ((elapsed = now_seconds() - start) < BENCH_MIN_SECONDS);
+   printf("  serialize:   %8.1f MB/s  %8.1f us\n",
+         (double)size * count / elapsed / 1e6, elapsed * 1e6 / count);
+
+   count = 0;
+   start = now_seconds();
+   do
+   {
+      if (!p_retro_unserialize(state, size))
+      {
+         fprintf(stderr, "Failed to unserialize\n");
+         return 1;
+      }
+      count++;
+   } while ((elapsed = now_seconds() - start) < BENCH_MIN_SECONDS);
+   printf("  unserialize: %8.1f MB/s  %8.1f us\n",
+         (double)size * count / elapsed / 1e6, elapsed * 1e6 / count);
+
+   free(state);
+   p_retro_unload_game();
+   p_retro_deinit();
+   return 0;
+}
@@ -54,6 +54,7 @@ void alarm_context_init(alarm_context_t *context, const char *name)
 
     context->num_pending_alarms = 0;
     context->next_pending_alarm_clk = (CLOCK) ~0L;
+    context->next_pending_alarm = NULL;
 }
 
 void alarm_context_destroy(alarm_context_t *context)
@@ -167,7 +168,8 @@ void alarm_destroy(alarm_t *alarm)
 void alarm_unset(alarm_t *alarm)
 {
     alarm_context_t *context;
-    int idx;
+    int idx, last;
+    unsigned int slot;
 
     idx = alarm->pending_idx;
 
@@ -176,34 +178,35 @@ void alarm_unset(alarm_t *alarm)
     }
     context = alarm->context;
 
-    if (context->num_pending_alarms > 1) {
-        int last;
-
-        last = --context->num_pending_alarms;
-
-        if (last != idx) {
-            /* Let's copy the struct by hand to make sure stupid compilers
-               don't do stupid things.  */
-            context->pending_alarms[idx].alarm
-                = context->pending_alarms[last].alarm;
-            context->pending_alarms[idx].clk
-                = context->pending_alarms[last].clk;
+    slot = context->pending_alarms[idx].slot;
+    last = (int)(--context->num_pending_alarms);
+    alarm->pending_idx = -1;
 
-            context->pending_alarms[idx].alarm->pending_idx = idx;
+    if (last != idx) {
+        /* Fill the hole with the last heap entry and restore the heap
+           property from there.  */
+        context->pending_alarms[idx] = context->pending_alarms[last];
+        if (idx > 0 && alarm_pending_before(&context->pending_alarms[idx],
+                                            &context->pending_alarms[(idx - 1) >> 1])) {
+            alarm_context_sift_up(context, (unsigned int)idx);
+        } else {
+            alarm_context_sift_down(context, (unsigned int)idx);
         }
+    }
 
-        if (context->next_pending_alarm_idx == idx) {
-            alarm_context_update_next_pending(context);
-        } else if (context->next_pending_alarm_idx == last) {
-            context->next_pending_alarm_idx = idx;
-        }
-    } else {
-        context->num_pending_alarms = 0;
-        context->next_pending_alarm_clk = (CLOCK) ~0L;
-        context->next_pending_alarm_idx = -1;
+    if (slot != (unsigned int)last) {
+        /* The alarm in the last slot moves into the freed one, which
+           dispatches it later among alarms due on the same clock.  */
+        alarm_t *moved = context->pending_slots[last];
+
+        context->pending_slots[slot] = moved;
+        context->pending_alarms[moved->pending_idx].slot = slot;
+        alarm_context_sift_down(context, (unsigned int)moved->pending_idx);
     }
 
-    alarm->pending_idx = -1;
+    if (alarm == context->next_pending_alarm) {
+        alarm_context_update_next_pending(context);
+    }
 }
 
 void alarm_log_too_many_alarms(void)
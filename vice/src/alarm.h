@@ -45,7 +45,7 @@ struct alarm_s {
     /* Callback to be called when the alarm is dispatched.  */
     alarm_callback_t callback;
 
-    /* Index into the pending alarm list.  If < 0, the alarm is not
+    /* Index into the pending alarm heap.  If < 0, the alarm is not
        pending.  */
     int pending_idx;
 
@@ -63,6 +63,10 @@ struct pending_alarms_s {
 
     /* Clock tick at which this alarm should be activated.  */
     CLOCK clk;
+
+    /* Slot of the alarm in the order it was made pending, see
+       `pending_slots'.  */
+    unsigned int slot;
 };
 typedef struct pending_alarms_s pending_alarms_t;
 
@@ -74,16 +78,23 @@ struct alarm_context_s {
     /* Alarm list.  */
     struct alarm_s *alarms;
 
-    /* Pending alarm array.  Statically allocated because it's slightly
-       faster this way.  */
+    /* Pending alarm array, kept as binary min-heap ordered by clock so
+       the next alarm is always at index 0.  Statically allocated because
+       it's slightly faster this way.  */
     pending_alarms_t pending_alarms[ALARM_CONTEXT_MAX_PENDING_ALARMS];
     unsigned int num_pending_alarms;
 
+    /* Pending alarms by slot: a new alarm takes the next slot, and an
+       unset one hands its slot to the alarm in the last slot.  This is
+       where the alarms used to sit in the unordered pending array, which
+       was scanned last slot first.  */
+    struct alarm_s *pending_slots[ALARM_CONTEXT_MAX_PENDING_ALARMS];
+
     /* Clock tick for the next pending alarm.  */
     CLOCK next_pending_alarm_clk;
 
-    /* Pending alarm number.  */
-    int next_pending_alarm_idx;
+    /* Next pending alarm, NULL if no alarm is pending.  */
+    struct alarm_s *next_pending_alarm;
 };
 typedef struct alarm_context_s alarm_context_t;
 
@@ -109,38 +120,93 @@ inline static CLOCK alarm_context_next_pending_clk(alarm_context_t *context)
     return context->next_pending_alarm_clk;
 }
 
-inline static void alarm_context_update_next_pending(alarm_context_t *context)
+/* Return non-zero if pending alarm `a' is dispatched before `b'.  */
+inline static int alarm_pending_before(const pending_alarms_t *a,
+                                       const pending_alarms_t *b)
 {
-    CLOCK next_pending_alarm_clk = (CLOCK)~0L;
-    int next_pending_alarm_idx;
-    unsigned int i;
+    return a->clk < b->clk || (a->clk == b->clk && a->slot > b->slot);
+}
 
-    next_pending_alarm_idx = context->next_pending_alarm_idx;
+/* Move the pending alarm at `idx' towards the root while it is due
+   earlier than its parent.  */
+inline static void alarm_context_sift_up(alarm_context_t *context,
+                                         unsigned int idx)
+{
+    pending_alarms_t *heap = context->pending_alarms;
+    pending_alarms_t item = heap[idx];
 
-    for (i = 0; i < context->num_pending_alarms; i++) {
-        CLOCK pending_clk = context->pending_alarms[i].clk;
+    while (idx > 0) {
+        unsigned int parent = (idx - 1) >> 1;
 
-        if (pending_clk <= next_pending_alarm_clk) {
-            next_pending_alarm_clk = pending_clk;
-            next_pending_alarm_idx = (int)i;
+        if (!alarm_pending_before(&item, &heap[parent])) {
+            break;
         }
+        heap[idx] = heap[parent];
+        heap[idx].alarm->pending_idx = (int)idx;
+        idx = parent;
     }
 
-    context->next_pending_alarm_clk = next_pending_alarm_clk;
-    context->next_pending_alarm_idx = next_pending_alarm_idx;
+    heap[idx] = item;
+    item.alarm->pending_idx = (int)idx;
 }
 
+/* Move the pending alarm at `idx' towards the leaves while it is due
+   later than one of its children.  */
+inline static void alarm_context_sift_down(alarm_context_t *context,
+                                           unsigned int idx)
+{
+    pending_alarms_t *heap = context->pending_alarms;
+    pending_alarms_t item = heap[idx];
+    unsigned int num = context->num_pending_alarms;
+
+    while (1) {
+        unsigned int child = 2 * idx + 1;
+
+        if (child >= num) {
+            break;
+        }
+        if (child + 1 < num
+            && alarm_pending_before(&heap[child + 1], &heap[child])) {
+            child++;
+        }
+        if (!alarm_pending_before(&heap[child], &item)) {
+            break;
+        }
+        heap[idx] = heap[child];
+        heap[idx].alarm->pending_idx = (int)idx;
+        idx = child;
+    }
+
+    heap[idx] = item;
+    item.alarm->pending_idx = (int)idx;
+}
+
+/* Make the root of the heap the next alarm: of the alarms due first, the
+   one in the highest slot.  */
+inline static void alarm_context_update_next_pending(alarm_context_t *context)
+{
+    if (context->num_pending_alarms > 0) {
+        context->next_pending_alarm_clk = context->pending_alarms[0].clk;
+        context->next_pending_alarm = context->pending_alarms[0].alarm;
+    } else {
+        context->next_pending_alarm_clk = (CLOCK)~0L;
+        context->next_pending_alarm = NULL;
+    }
+}
+
+/* Dispatch the next pending alarm.  An alarm that becomes due on the same
+   clock as the next one does not take its place, the next alarm is only
+   picked again when it is set or unset itself or an earlier one comes in.
+   This keeps the order of the linear scan the heap replaced.  */
 inline static void alarm_context_dispatch(alarm_context_t *context,
                                           CLOCK cpu_clk)
 {
     CLOCK offset;
-    int idx;
     alarm_t *alarm;
 
     offset = (CLOCK)(cpu_clk - context->next_pending_alarm_clk);
 
-    idx = context->next_pending_alarm_idx;
-    alarm = context->pending_alarms[idx].alarm;
+    alarm = context->next_pending_alarm;
 
     (alarm->callback)(offset, alarm->data);
 }
@@ -166,21 +232,31 @@ inline static void alarm_set(alarm_t *alarm, CLOCK cpu_clk)
 
         context->pending_alarms[new_idx].alarm = alarm;
         context->pending_alarms[new_idx].clk = cpu_clk;
+        context->pending_alarms[new_idx].slot = (unsigned int)new_idx;
+        context->pending_slots[new_idx] = alarm;
 
         context->num_pending_alarms++;
 
+        alarm_context_sift_up(context, (unsigned int)new_idx);
+
         if (cpu_clk < context->next_pending_alarm_clk) {
             context->next_pending_alarm_clk = cpu_clk;
-            context->next_pending_alarm_idx = new_idx;
+            context->next_pending_alarm = alarm;
         }
-
-        alarm->pending_idx = new_idx;
     } else {
         /* Already pending: modify.  */
 
+        CLOCK old_clk = context->pending_alarms[idx].clk;
+
         context->pending_alarms[idx].clk = cpu_clk;
+        if (cpu_clk < old_clk) {
+            alarm_context_sift_up(context, (unsigned int)idx);
+        } else {
+            alarm_context_sift_down(context, (unsigned int)idx);
+        }
+
         if (context->next_pending_alarm_clk > cpu_clk
-            || idx == context->next_pending_alarm_idx) {
+            || alarm == context->next_pending_alarm) {
             alarm_context_update_next_pending(context);
         }
     }
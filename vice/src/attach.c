@@ -43,6 +43,7 @@
 #include "network.h"
 #include "resources.h"
 #include "serial.h"
+#include "snapshot.h"
 #include "types.h"
 #include "uiapi.h"
 #include "vdrive-bam.h"
@@ -306,6 +307,41 @@ void file_system_shutdown(void)
     }
 }
 
+/* Called at every vsync, writes back cached image changes once they are due
+   even if the disk is not written to again */
+void file_system_vsync_hook(void)
+{
+    unsigned int i, j;
+
+    for (i = 0; i < NUM_DISK_UNITS; i++) {
+        for (j = 0; j < NUM_DRIVES; j++) {
+            vdrive_t *vdrive = file_system[i][j].vdrive;
+
+            if (vdrive != NULL && vdrive->image != NULL) {
+                disk_image_sync(vdrive->image);
+            }
+        }
+    }
+}
+
+/* Return 1 if any attached image has written data not in its file yet */
+int file_system_write_pending(void)
+{
+    unsigned int i, j;
+
+    for (i = 0; i < NUM_DISK_UNITS; i++) {
+        for (j = 0; j < NUM_DRIVES; j++) {
+            vdrive_t *vdrive = file_system[i][j].vdrive;
+
+            if (vdrive != NULL && vdrive->image != NULL
+                && disk_image_write_pending(vdrive->image)) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
 struct vdrive_s *file_system_get_vdrive(unsigned int unit, unsigned int drive)
 {
     if (unit < 8 || unit >= 8 + NUM_DISK_UNITS) {
@@ -642,6 +678,10 @@ static int file_system_attach_disk_internal(unsigned int unit, unsigned int driv
 {
     vdrive_t *vdrive;
 
+#ifdef __LIBRETRO__
+    snapshot_size_invalidate();
+#endif
+
     vdrive = file_system_get_vdrive(unit, drive);
     /* FIXME: Is this clever?  */
     vdrive_device_setup(vdrive, unit, drive);
@@ -682,6 +722,9 @@ static void file_system_detach_disk_single(unsigned int unit, unsigned int drive
 
     vdrive = file_system_get_vdrive(unit, drive);
     if (vdrive != NULL && vdrive->image != NULL) {
+#ifdef __LIBRETRO__
+        snapshot_size_invalidate();
+#endif
         detach_disk_image_and_free(vdrive->image, vdrive, unit, drive);
         ui_display_drive_current_image(unit - 8, drive, "");
     }
@@ -50,6 +50,8 @@ extern void file_system_detach_disk_shutdown(void);
 extern struct vdrive_s *file_system_get_vdrive(unsigned int unit, unsigned int drive);
 extern int file_system_bam_get_disk_id(unsigned int unit, unsigned int drive, uint8_t *id);
 extern int file_system_bam_set_disk_id(unsigned int unit, unsigned int drive, uint8_t *id);
+extern void file_system_vsync_hook(void);
+extern int file_system_write_pending(void);
 extern void file_system_event_playback(unsigned int unit, unsigned int drive, const char *filename);
 
 #endif
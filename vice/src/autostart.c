@@ -38,6 +38,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#ifdef __LIBRETRO__
+#include <sys/stat.h>
+#endif
 
 #include "archdep.h"
 #include "autostart.h"
@@ -46,6 +50,7 @@
 #include "cartridge.h"
 #include "charset.h"
 #include "cmdline.h"
+#include "crc32.h"
 #include "datasette.h"
 #include "diskimage.h"
 #include "drive.h"
@@ -72,6 +77,7 @@
 #include "network.h"
 #include "resources.h"
 #include "snapshot.h"
+#include "sysfile.h"
 #include "tape.h"
 #include "tapecart.h"
 #include "types.h"
@@ -82,12 +88,15 @@
 #include "vice-event.h"
 
 #ifdef __LIBRETRO__
+#include "encodings/utf.h"
 #include "keyboard.h"
 #include "libretro.h"
 #include "libretro-glue.h"
+#include "libretro-metacache.h"
 extern unsigned int opt_autostart;
 extern unsigned int opt_work_disk_type;
 extern unsigned int opt_work_disk_unit;
+extern bool retro_cartridge_attached(void);
 #endif
 
 #ifdef DEBUG_AUTOSTART
@@ -717,6 +726,263 @@ static void load_snapshot_trap(uint16_t unused_addr, void *unused_data)
     mon_update_all_checkpoint_state();
 }
 
+#ifdef __LIBRETRO__
+/* ------------------------------------------------------------------------- */
+
+/* Boot snapshot cache: the machine state at the first "READY." after a cold
+   boot is kept in the save directory, keyed by a hash of everything that
+   shapes that state, and later autostarts restore it instead of running the
+   KERNAL reset sequence. */
+
+/* Resources not covered by the event-safe list that still change the boot */
+static const char * const boot_cache_resources[] = {
+    "Drive8Type", "Drive9Type", "Drive10Type", "Drive11Type",
+    "DriveTrueEmulation", "VirtualDevices",
+    "REU", "REUsize", "GEORAM", "GEORAMsize", "RAMCART", "RAMCARTsize",
+    NULL
+};
+
+/* ROM resources, hashed by the contents of the file they name */
+static const char * const boot_cache_roms[] = {
+    "KernalName", "BasicName", "ChargenName",
+    "DosName1540", "DosName1541", "DosName1541ii", "DosName1570",
+    "DosName1571", "DosName1581",
+    NULL
+};
+
+/* Boot snapshots kept in the save directory, the oldest go first */
+#define BOOT_CACHE_MAX_FILES 8
+
+/* Snapshot file of the configuration being autostarted */
+static char *boot_cache_file = NULL;
+
+/* Flag: restore the boot snapshot once the machine has been reset */
+static int boot_cache_restore = 0;
+
+/* Flag: take the boot snapshot at the next "READY." */
+static int boot_cache_capture = 0;
+
+static void boot_cache_append(uint8_t **buf, size_t *len, const void *data, size_t size)
+{
+    *buf = lib_realloc(*buf, *len + size);
+    memcpy(*buf + *len, data, size);
+    *len += size;
+}
+
+static char *boot_cache_get_file_name(void)
+{
+    event_list_state_t list;
+    event_list_t *item;
+    const char *name = machine_get_name();
+    uint8_t *buf = NULL;
+    size_t len = 0;
+    char *value, *file_name;
+    uint32_t crc;
+    int i;
+
+    boot_cache_append(&buf, &len, name, strlen(name) + 1);
+
+    event_register_event_list(&list);
+    resources_get_event_safe_list(&list);
+    for (item = list.base; item->type != EVENT_LIST_END; item = item->next) {
+        boot_cache_append(&buf, &len, item->data, item->size);
+    }
+    event_clear_list(&list);
+
+    for (i = 0; boot_cache_resources[i] != NULL; i++) {
+        if (resources_query_type(boot_cache_resources[i]) == (resource_type_t)-1) {
+            continue;
+        }
+        value = resources_write_item_to_string(boot_cache_resources[i], "\n");
+        if (value != NULL) {
+            boot_cache_append(&buf, &len, value, strlen(value));
+            lib_free(value);
+        }
+    }
+
+    /* ROMs by contents, a changed file under the same name boots differently */
+    for (i = 0; boot_cache_roms[i] != NULL; i++) {
+        const char *rom_name = NULL;
+        char *rom_path = NULL;
+
+        if (resources_get_string(boot_cache_roms[i], &rom_name) < 0
+            || rom_name == NULL || rom_name[0] == '\0') {
+            continue;
+        }
+        if (sysfile_locate(rom_name, &rom_path) == 0) {
+            crc = crc32_file(rom_path);
+            boot_cache_append(&buf, &len, &crc, sizeof(crc));
+        } else {
+            /* built-in image */
+            boot_cache_append(&buf, &len, rom_name, strlen(rom_name) + 1);
+        }
+        lib_free(rom_path);
+    }
+
+    crc = crc32_buf((const char *)buf, (unsigned int)len);
+    lib_free(buf);
+
+    file_name = lib_msprintf("%s%svice_boot_%s_%08x.vsf",
+                             retro_save_directory, FSDEV_DIR_SEP_STR, name, crc);
+    return file_name;
+}
+
+/* Only plain disk and PRG autostarts qualify: tape and cartridge state would
+   be captured into, and restored from, the shared snapshot. */
+static int boot_cache_usable(unsigned int mode)
+{
+    int rnd = 0;
+
+    if (mode != AUTOSTART_HASDISK && mode != AUTOSTART_INJECT) {
+        return 0;
+    }
+
+    resources_get_int("AutostartDelayRandom", &rnd);
+
+    if (retro_save_directory[0] == '\0'
+        || AutostartDelay != 0 || rnd
+        || network_connected() || event_record_active() || event_playback_active()
+        || (tape_image_dev1 != NULL && tape_image_dev1->name != NULL)
+        || retro_cartridge_attached()) {
+        return 0;
+    }
+
+    return 1;
+}
+
+static int boot_cache_get_mtime(const char *path, time_t *mtime)
+{
+    struct stat st;
+    int ret;
+#ifdef USE_LIBRETRO_VFS
+    char *local = utf8_to_local_string_alloc(path);
+
+    ret = stat(local ? local : path, &st);
+    free(local);
+#else
+    ret = stat(path, &st);
+#endif
+    if (ret != 0) {
+        return -1;
+    }
+    *mtime = st.st_mtime;
+    return 0;
+}
+
+/* Keep at most BOOT_CACHE_MAX_FILES boot snapshots, removing the oldest */
+static void boot_cache_evict(void)
+{
+    ioutil_dir_t *dir;
+    char *entry, *path, *oldest_path;
+    time_t mtime, oldest_mtime;
+    int count;
+
+    for (;;) {
+        dir = ioutil_opendir(retro_save_directory, IOUTIL_OPENDIR_NO_DOTFILES);
+        if (dir == NULL) {
+            return;
+        }
+
+        count = 0;
+        oldest_path = NULL;
+        oldest_mtime = 0;
+        while ((entry = ioutil_readdir(dir)) != NULL) {
+            if (strncmp(entry, "vice_boot_", 10) != 0) {
+                continue;
+            }
+            path = lib_msprintf("%s%s%s", retro_save_directory, FSDEV_DIR_SEP_STR, entry);
+            if (boot_cache_get_mtime(path, &mtime) < 0) {
+                lib_free(path);
+                continue;
+            }
+            count++;
+            if (oldest_path == NULL || mtime < oldest_mtime) {
+                lib_free(oldest_path);
+                oldest_path = path;
+                oldest_mtime = mtime;
+            } else {
+                lib_free(path);
+            }
+        }
+        ioutil_closedir(dir);
+
+        if (count <= BOOT_CACHE_MAX_FILES || oldest_path == NULL
+            || strcmp(oldest_path, boot_cache_file) == 0
+            || ioutil_remove(oldest_path) != 0) {
+            lib_free(oldest_path);
+            return;
+        }
+        log_message(autostart_log, "Boot snapshot `%s' evicted.", oldest_path);
+        lib_free(oldest_path);
+    }
+}
+
+static void boot_cache_save_trap(uint16_t unused_addr, void *unused_data)
+{
+    if (boot_cache_file == NULL) {
+        return;
+    }
+
+    if (machine_write_snapshot(boot_cache_file, 0, 0, 0) < 0) {
+        log_warning(autostart_log, "Cannot write boot snapshot `%s'.", boot_cache_file);
+        ioutil_remove(boot_cache_file);
+    } else {
+        log_message(autostart_log, "Boot snapshot saved to `%s'.", boot_cache_file);
+        boot_cache_evict();
+    }
+}
+
+static void boot_cache_load_trap(uint16_t unused_addr, void *unused_data)
+{
+    unsigned int dnr, d;
+
+    if (boot_cache_file == NULL || machine_read_snapshot(boot_cache_file, 0) < 0) {
+        /* stale or broken, take the long way and capture a new one */
+        log_warning(autostart_log, "Cannot read boot snapshot, resetting.");
+        if (boot_cache_file != NULL) {
+            ioutil_remove(boot_cache_file);
+        }
+        mem_powerup();
+        boot_cache_capture = 1;
+        autostart_ignore_reset = 1;
+        autostart_wait_for_reset = 1;
+        machine_trigger_reset(MACHINE_RESET_MODE_HARD);
+        return;
+    }
+
+    /* The drive module brings back the write protection of the disk that was
+       attached when the snapshot was taken. The disk ID comes from the image
+       itself, which the snapshot does not carry. */
+    for (dnr = 0; dnr < NUM_DISK_UNITS; dnr++) {
+        for (d = 0; d < NUM_DRIVES; d++) {
+            drive_t *drive = diskunit_context[dnr]->drives[d];
+
+            if (drive != NULL && drive->image != NULL) {
+                drive->read_only = drive->image->read_only;
+            }
+        }
+    }
+
+    mon_update_all_checkpoint_state();
+
+    /* the machine is sitting at "READY." already */
+    autostart_initial_delay_cycles = 0;
+}
+
+/* Take the boot snapshot if one is due; returns 1 if the current state has
+   to be kept for one more frame until the trap has run. */
+static int boot_cache_check_capture(void)
+{
+    if (!boot_cache_capture) {
+        return 0;
+    }
+
+    boot_cache_capture = 0;
+    interrupt_maincpu_trigger_trap(boot_cache_save_trap, 0);
+    return 1;
+}
+#endif
+
 /* ------------------------------------------------------------------------- */
 
 /* Reset autostart.  */
@@ -976,6 +1242,11 @@ static void advance_hasdisk(int unit, int drive)
 
     switch (check("READY.", AUTOSTART_WAIT_BLINK)) {
         case YES:
+#ifdef __LIBRETRO__
+            if (boot_cache_check_capture()) {
+                break;
+            }
+#endif
 
             /* autostart_program_name may be petscii or ascii at this point,
                ANDing the charcodes with 0x7f here is a cheap way to prevent
@@ -1182,6 +1453,12 @@ static void advance_waitloadready(void)
 /* After a reset a PRG file has to be injected into RAM */
 static void advance_inject(void)
 {
+#ifdef __LIBRETRO__
+    if (check2("READY.", AUTOSTART_NOWAIT_BLINK, -1) == YES && boot_cache_check_capture()) {
+        return;
+    }
+    boot_cache_capture = 0;
+#endif
     if (autostart_prg_perform_injection(autostart_log) < 0) {
         disable_warp_if_was_requested();
         autostart_disable();
@@ -1201,6 +1478,12 @@ void autostart_advance(void)
 
     if (maincpu_clk < autostart_initial_delay_cycles) {
         autostart_wait_for_reset = 0;
+#ifdef __LIBRETRO__
+        if (boot_cache_restore) {
+            boot_cache_restore = 0;
+            interrupt_maincpu_trigger_trap(boot_cache_load_trap, 0);
+        }
+#endif
         return;
     }
 
@@ -1309,6 +1592,22 @@ static void reboot_for_autostart(const char *program_name, unsigned int mode,
     }
     DBG(("reboot_for_autostart - autostart_initial_delay_cycles: %u", autostart_initial_delay_cycles));
 
+#ifdef __LIBRETRO__
+    lib_free(boot_cache_file);
+    boot_cache_file = NULL;
+    boot_cache_restore = 0;
+    boot_cache_capture = 0;
+    if (boot_cache_usable(mode)) {
+        boot_cache_file = boot_cache_get_file_name();
+        if (util_file_exists(boot_cache_file)) {
+            log_message(autostart_log, "Using boot snapshot `%s'.", boot_cache_file);
+            boot_cache_restore = 1;
+        } else {
+            boot_cache_capture = 1;
+        }
+    }
+#endif
+
     machine_trigger_reset(MACHINE_RESET_MODE_HARD);
 
 /* FUUUUU and on *nix this causes funky results. wth! */
@@ -1505,10 +1804,26 @@ int autostart_disk(int unit, int drive, const char *file_name, const char *progr
     /* Get program name first to avoid more than one file handle open on
        image.  */
     if (!program_name && program_number > 0) {
-        image_contents_t *contents = diskcontents_filesystem_read(file_name);
-        if (contents) {
-            name = image_contents_filename_by_number(contents, program_number);
-            image_contents_destroy(contents);
+#ifdef __LIBRETRO__
+        char cached[METACACHE_DATA_MAX + 1];
+        size_t cached_len = METACACHE_DATA_MAX;
+
+        if (metacache_get(file_name, METACACHE_PROGRAM_NAME, program_number, cached, &cached_len)) {
+            cached[cached_len] = '\0';
+            name = lib_strdup(cached);
+        } else
+#endif
+        {
+            image_contents_t *contents = diskcontents_filesystem_read(file_name);
+            if (contents) {
+                name = image_contents_filename_by_number(contents, program_number);
+                image_contents_destroy(contents);
+            }
+#ifdef __LIBRETRO__
+            if (name) {
+                metacache_set(file_name, METACACHE_PROGRAM_NAME, program_number, name, strlen(name));
+            }
+#endif
         }
     } else {
         name = lib_strdup(program_name ? program_name : "*");
@@ -1806,12 +2121,97 @@ static void set_tapeport_device(int datasette, int tapecart)
     }
 }
 
+/* Image types tried by autostart_autodetect(), in probing order.  */
+enum {
+    AUTODETECT_DISK = 1,
+    AUTODETECT_TAPE,
+    AUTODETECT_TAPECART,
+    AUTODETECT_SNAPSHOT,
+    AUTODETECT_CARTRIDGE,
+    AUTODETECT_PRG
+};
+
+/* Try to autostart `file_name' as one image type only.  */
+static int autostart_autodetect_type(int type, int unit, int drive,
+                                     const char *file_name, const char *program_name,
+                                     unsigned int program_number, unsigned int runmode)
+{
+    int datasette_temp, tapecart_temp;
+
+    switch (type) {
+        case AUTODETECT_DISK:
+            if (autostart_disk(unit, drive, file_name, program_name, program_number, runmode) == 0) {
+                log_message(autostart_log, "`%s' recognized as disk image.", file_name);
+                return 0;
+            }
+            break;
+        case AUTODETECT_TAPE:
+        case AUTODETECT_TAPECART:
+            if (machine_class == VICE_MACHINE_C64DTV || machine_class == VICE_MACHINE_SCPU64) {
+                break;
+            }
+            if (resources_get_int("Datasette", &datasette_temp) < 0) {
+                log_error(LOG_ERR, "Failed to get Datasette status.");
+            }
+            if (resources_get_int("TapecartEnabled", &tapecart_temp) < 0) {
+                log_error(LOG_ERR, "Failed to get Tapecart status.");
+            }
+
+            if (type == AUTODETECT_TAPE) {
+                set_tapeport_device(1, 0);
+
+                if (autostart_tape(file_name, program_name, program_number, runmode) == 0) {
+                    log_message(autostart_log, "`%s' recognized as tape image.", file_name);
+                    return 0;
+                }
+            } else {
+                set_tapeport_device(0, 1);
+
+                if (autostart_tapecart(file_name, NULL) == 0) {
+                    log_message(autostart_log, "`%s' recognized as tapecart image.", file_name);
+                    return 0;
+                }
+            }
+
+            set_tapeport_device(datasette_temp, tapecart_temp);
+            break;
+        case AUTODETECT_SNAPSHOT:
+            if (autostart_snapshot(file_name, program_name) == 0) {
+                log_message(autostart_log, "`%s' recognized as snapshot image.",
+                            file_name);
+                return 0;
+            }
+            break;
+        case AUTODETECT_CARTRIDGE:
+            if ((machine_class == VICE_MACHINE_C64) || (machine_class == VICE_MACHINE_C64SC) ||
+               (machine_class == VICE_MACHINE_SCPU64) ||(machine_class == VICE_MACHINE_C128)) {
+                if (cartridge_attach_image(CARTRIDGE_CRT, file_name) == 0) {
+                    log_message(autostart_log, "`%s' recognized as cartridge image.",
+                                file_name);
+                    return 0;
+                }
+            }
+            break;
+        case AUTODETECT_PRG:
+            if (autostart_prg(file_name, runmode) == 0) {
+                log_message(autostart_log, "`%s' recognized as program/p00 file.",
+                            file_name);
+                return 0;
+            }
+            break;
+        default:
+            break;
+    }
+    return -1;
+}
+
 /* Autostart `file_name', trying to auto-detect its type.  */
 /* FIXME: pass device nr into this function */
 int autostart_autodetect(const char *file_name, const char *program_name,
                          unsigned int program_number, unsigned int runmode)
 {
     int unit = 8, drive = 0;
+    int type, cached_type = 0;
 #ifdef HAVE_NATIVE_GTK3
     if (!mainlock_is_vice_thread()) {
         mainlock_assert_lock_obtained();
@@ -1833,59 +2233,29 @@ int autostart_autodetect(const char *file_name, const char *program_name,
 
     log_message(autostart_log, "Autodetecting image type of `%s'.", file_name);
 
-    if (autostart_disk(unit, drive, file_name, program_name, program_number, runmode) == 0) {
-        log_message(autostart_log, "`%s' recognized as disk image.", file_name);
+#ifdef __LIBRETRO__
+    /* Probe the type found last time first, skipping the failing probes
+       before it.  */
+    if (metacache_get_int(file_name, METACACHE_IMAGE_TYPE, 0, &cached_type)
+            && autostart_autodetect_type(cached_type, unit, drive, file_name,
+                                         program_name, program_number, runmode) == 0) {
         return 0;
     }
+#endif
 
-    if (machine_class != VICE_MACHINE_C64DTV && machine_class != VICE_MACHINE_SCPU64) {
-        int datasette_temp, tapecart_temp;
-
-        if (resources_get_int("Datasette", &datasette_temp) < 0) {
-            log_error(LOG_ERR, "Failed to get Datasette status.");
-        }
-        if (resources_get_int("TapecartEnabled", &tapecart_temp) < 0) {
-            log_error(LOG_ERR, "Failed to get Tapecart status.");
-        }
-
-        set_tapeport_device(1, 0);
-
-        if (autostart_tape(file_name, program_name, program_number, runmode) == 0) {
-            log_message(autostart_log, "`%s' recognized as tape image.", file_name);
-            return 0;
-        }
-
-        set_tapeport_device(0, 1);
-
-        if (autostart_tapecart(file_name, NULL) == 0) {
-            log_message(autostart_log, "`%s' recognized as tapecart image.", file_name);
-            return 0;
+    for (type = AUTODETECT_DISK; type <= AUTODETECT_PRG; type++) {
+        if (type == cached_type) {
+            continue;
         }
-
-        set_tapeport_device(datasette_temp, tapecart_temp);
-    }
-
-    if (autostart_snapshot(file_name, program_name) == 0) {
-        log_message(autostart_log, "`%s' recognized as snapshot image.",
-                    file_name);
-        return 0;
-    }
-
-    if ((machine_class == VICE_MACHINE_C64) || (machine_class == VICE_MACHINE_C64SC) ||
-       (machine_class == VICE_MACHINE_SCPU64) ||(machine_class == VICE_MACHINE_C128)) {
-        if (cartridge_attach_image(CARTRIDGE_CRT, file_name) == 0) {
-            log_message(autostart_log, "`%s' recognized as cartridge image.",
-                        file_name);
+        if (autostart_autodetect_type(type, unit, drive, file_name,
+                                      program_name, program_number, runmode) == 0) {
+#ifdef __LIBRETRO__
+            metacache_set_int(file_name, METACACHE_IMAGE_TYPE, 0, type);
+#endif
             return 0;
         }
     }
 
-    if (autostart_prg(file_name, runmode) == 0) {
-        log_message(autostart_log, "`%s' recognized as program/p00 file.",
-                    file_name);
-        return 0;
-    }
-
     log_error(autostart_log, "`%s' is not a valid file.", file_name);
     return -1;
 }
@@ -1953,6 +2323,10 @@ void autostart_reset(void)
 void autostart_shutdown(void)
 {
     deallocate_program_name();
+#ifdef __LIBRETRO__
+    lib_free(boot_cache_file);
+    boot_cache_file = NULL;
+#endif
 
     autostart_prg_shutdown();
 }
@@ -25,6 +25,7 @@
 
 #include "vice.h"
 
+#include "c64mem.h"
 #include "maincpu.h"
 #include "mem.h"
 
@@ -128,6 +129,37 @@ static uint8_t memmap_mem_read_dummy(unsigned int addr)
 }
 #endif
 
+#ifndef FEATURE_CPUMEMHISTORY
+/* Plain RAM pages are accessed directly, everything else (I/O, ROM,
+   cartridges, VIC-II bank writes) goes through the callbacks.  */
+inline static uint8_t mem_read_ram_fast(unsigned int addr)
+{
+    uint8_t *base = _mem_read_ram_tab_ptr[addr >> 8];
+
+    if (base) {
+        return base[addr];
+    }
+    return (*_mem_read_tab_ptr[addr >> 8])((uint16_t)addr);
+}
+
+inline static void mem_store_ram_fast(unsigned int addr, uint8_t value)
+{
+    uint8_t *base = _mem_write_ram_tab_ptr[addr >> 8];
+
+    if (base) {
+        base[addr] = value;
+    } else {
+        (*_mem_write_tab_ptr[addr >> 8])((uint16_t)addr, value);
+    }
+}
+
+#define LOAD(addr) \
+    mem_read_ram_fast(addr)
+
+#define STORE(addr, value) \
+    mem_store_ram_fast(addr, (uint8_t)(value))
+#endif
+
 static void check_and_run_alternate_cpu(void)
 {
     cpmcart_check_and_run_z80();
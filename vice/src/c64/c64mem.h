@@ -83,6 +83,11 @@ extern void mem_set_write_hook(int config, int page, store_func_t *f);
 extern void mem_read_tab_set(unsigned int base, unsigned int index, read_func_ptr_t read_func);
 extern void mem_read_base_set(unsigned int base, unsigned int index, uint8_t *mem_ptr);
 
+/* Base pointers of the plain RAM pages in the current configuration, NULL
+   for pages that need the read/write callbacks.  */
+extern uint8_t **_mem_read_ram_tab_ptr;
+extern uint8_t **_mem_write_ram_tab_ptr;
+
 extern void mem_store_without_ultimax(uint16_t addr, uint8_t value);
 extern uint8_t mem_read_without_ultimax(uint16_t addr);
 extern void mem_store_without_romlh(uint16_t addr, uint8_t value);
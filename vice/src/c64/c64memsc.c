@@ -111,6 +111,16 @@ static read_func_ptr_t mem_read_tab[NUM_CONFIGS][0x101];
 static uint8_t *mem_read_base_tab[NUM_CONFIGS][0x101];
 static uint32_t mem_read_limit_tab[NUM_CONFIGS][0x101];
 
+/* Plain RAM pages of the read and write tables (base pointer, or NULL
+   when the callback has to be used).  */
+static uint8_t *mem_read_ram_tab[NUM_CONFIGS][0x101];
+static uint8_t *mem_write_ram_tab[NUM_CONFIGS][0x101];
+static uint8_t *mem_ram_tab_none[0x101];
+
+/* Pointers to the currently used plain RAM tables.  */
+uint8_t **_mem_read_ram_tab_ptr = mem_ram_tab_none;
+uint8_t **_mem_write_ram_tab_ptr = mem_ram_tab_none;
+
 static store_func_ptr_t mem_write_tab_watch[0x101];
 static read_func_ptr_t mem_read_tab_watch[0x101];
 
@@ -175,12 +185,34 @@ static void mem_update_tab_ptrs(int flag)
             _mem_read_tab_ptr_dummy = mem_read_tab[mem_config];
             _mem_write_tab_ptr_dummy = mem_write_tab[mem_config];
         }
+        /* every access has to pass the watch callbacks */
+        _mem_read_ram_tab_ptr = mem_ram_tab_none;
+        _mem_write_ram_tab_ptr = mem_ram_tab_none;
     } else {
         /* all watchpoints disabled */
         _mem_read_tab_ptr = mem_read_tab[mem_config];
         _mem_write_tab_ptr = mem_write_tab[mem_config];
         _mem_read_tab_ptr_dummy = mem_read_tab[mem_config];
         _mem_write_tab_ptr_dummy = mem_write_tab[mem_config];
+        _mem_read_ram_tab_ptr = mem_read_ram_tab[mem_config];
+        _mem_write_ram_tab_ptr = mem_write_ram_tab[mem_config];
+    }
+}
+
+/* Collect the pages served by plain `ram_read()'/`ram_store()' so the CPU
+   can access them without the callbacks.  */
+static void mem_update_ram_tabs(void)
+{
+    int i, j;
+
+    for (i = 0; i < NUM_CONFIGS; i++) {
+        for (j = 0; j <= 0xff; j++) {
+            mem_read_ram_tab[i][j] = (mem_read_tab[i][j] == ram_read) ? mem_ram : NULL;
+            mem_write_ram_tab[i][j] = (mem_write_tab[i][j] == ram_store) ? mem_ram : NULL;
+        }
+        /* accesses wrapping past $ffff always use the callbacks */
+        mem_read_ram_tab[i][0x100] = NULL;
+        mem_write_ram_tab[i][0x100] = NULL;
     }
 }
 
@@ -634,11 +666,13 @@ static void plus60k_init_config(void)
 void mem_set_write_hook(int config, int page, store_func_t *f)
 {
     mem_write_tab[config][page] = f;
+    mem_write_ram_tab[config][page] = (f == ram_store && page < 0x100) ? mem_ram : NULL;
 }
 
 void mem_read_tab_set(unsigned int base, unsigned int index, read_func_ptr_t read_func)
 {
     mem_read_tab[base][index] = read_func;
+    mem_read_ram_tab[base][index] = (read_func == ram_read && index < 0x100) ? mem_ram : NULL;
 }
 
 void mem_read_base_set(unsigned int base, unsigned int index, uint8_t *mem_ptr)
@@ -749,6 +783,9 @@ void mem_initialize_memory(void)
     plus256k_init_config();
     c64_256k_init_config();
 
+    mem_update_ram_tabs();
+    mem_update_tab_ptrs(watchpoints_active);
+
     if (board == 1) {
         mem_limit_max_init(mem_read_limit_tab);
     }
@@ -54,6 +54,7 @@
 #include "mem.h"
 #include "monitor.h"
 #include "resources.h"
+#include "snapshot.h"
 #include "util.h"
 
 /* #define DEBUGCART */
@@ -572,6 +573,10 @@ int cartridge_attach_image(int type, const char *filename)
         return -1;
     }
 
+#ifdef __LIBRETRO__
+    snapshot_size_invalidate();
+#endif
+
     /* Attaching no cartridge always works. */
     if (type == CARTRIDGE_NONE || *filename == '\0') {
         return 0;
@@ -734,6 +739,10 @@ void cart_detach_slotmain(void)
 */
 void cartridge_detach_image(int type)
 {
+#ifdef __LIBRETRO__
+    snapshot_size_invalidate();
+#endif
+
     if (type == 0) {
         DBG(("CART: detach MAIN ID: %d\n", type));
         cart_detach_slotmain();
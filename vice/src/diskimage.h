@@ -137,6 +137,8 @@ extern int disk_image_read_sector(const disk_image_t *image, uint8_t *buf,
                                   const disk_addr_t *dadr);
 extern int disk_image_write_sector(disk_image_t *image, const uint8_t *buf,
                                    const disk_addr_t *dadr);
+extern void disk_image_sync(disk_image_t *image);
+extern int disk_image_write_pending(const disk_image_t *image);
 extern int disk_image_check_sector(const disk_image_t *image, unsigned int track,
                                    unsigned int sector);
 extern unsigned int disk_image_sector_per_track(unsigned int format,
@@ -691,6 +691,23 @@ int disk_image_write_sector(disk_image_t *image, const uint8_t *buf, const disk_
     return rc;
 }
 
+/* Write back delayed changes that are due, called periodically */
+void disk_image_sync(disk_image_t *image)
+{
+    if (image->device == DISK_IMAGE_DEVICE_FS) {
+        fsimage_flush_due(image);
+    }
+}
+
+/* Return 1 if written data has not reached the file yet */
+int disk_image_write_pending(const disk_image_t *image)
+{
+    if (image->device == DISK_IMAGE_DEVICE_FS) {
+        return fsimage_write_pending(image);
+    }
+    return 0;
+}
+
 /*-----------------------------------------------------------------------*/
 
 int disk_image_write_half_track(disk_image_t *image, unsigned int half_track,
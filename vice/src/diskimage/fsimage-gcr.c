@@ -69,16 +69,17 @@ int fsimage_read_gcr_image(const disk_image_t *image)
 /*-----------------------------------------------------------------------*/
 /* Seek to half track */
 
-static long fsimage_gcr_seek_half_track(fsimage_t *fsimage, unsigned int half_track,
+static long fsimage_gcr_seek_half_track(const disk_image_t *image, unsigned int half_track,
                                         uint16_t *max_track_length, uint8_t *num_half_tracks)
 {
+    fsimage_t *fsimage = image->media.fsimage;
     uint8_t buf[12];
 
     if (fsimage->fd == NULL) {
         log_error(fsimage_gcr_log, "Attempt to read without disk image.");
         return -1;
     }
-    if (util_fpread(fsimage->fd, buf, 12, 0) < 0) {
+    if (fsimage_pread(image, buf, 12, 0) < 0) {
         log_error(fsimage_gcr_log, "Could not read GCR disk image.");
         return -1;
     }
@@ -105,7 +106,7 @@ static long fsimage_gcr_seek_half_track(fsimage_t *fsimage, unsigned int half_tr
     }
 #endif
 
-    if (util_fpread(fsimage->fd, buf, 4, 12 + (half_track - 2) * 4) < 0) {
+    if (fsimage_pread(image, buf, 4, 12 + (half_track - 2) * 4) < 0) {
         log_error(fsimage_gcr_log, "Could not read GCR disk image.");
         return -1;
     }
@@ -121,23 +122,20 @@ int fsimage_gcr_read_half_track(const disk_image_t *image, unsigned int half_tra
     uint16_t track_len;
     uint8_t buf[4];
     long offset;
-    fsimage_t *fsimage;
     uint16_t max_track_length;
     uint8_t num_half_tracks;
 
-    fsimage = image->media.fsimage;
-
     raw->data = NULL;
     raw->size = 0;
 
-    offset = fsimage_gcr_seek_half_track(fsimage, half_track, &max_track_length, &num_half_tracks);
+    offset = fsimage_gcr_seek_half_track(image, half_track, &max_track_length, &num_half_tracks);
 
     if (offset < 0) {
         return -1;
     }
 
     if (offset != 0) {
-        if (util_fpread(fsimage->fd, buf, 2, offset) < 0) {
+        if (fsimage_pread(image, buf, 2, offset) < 0) {
             log_error(fsimage_gcr_log, "Could not read GCR disk image.");
             return -1;
         }
@@ -154,7 +152,7 @@ int fsimage_gcr_read_half_track(const disk_image_t *image, unsigned int half_tra
         raw->data = lib_calloc(1, track_len);
         raw->size = track_len;
 
-        if (fread(raw->data, track_len, 1, fsimage->fd) < 1) {
+        if (fsimage_pread(image, raw->data, track_len, offset + 2) < 0) {
             log_error(fsimage_gcr_log, "Could not read GCR disk image.");
             return -1;
         }
@@ -184,12 +182,11 @@ int fsimage_gcr_write_half_track(disk_image_t *image, unsigned int half_track,
     uint16_t max_track_length;
     uint8_t buf[4];
     long offset;
-    fsimage_t *fsimage;
     uint8_t num_half_tracks;
 
-    fsimage = image->media.fsimage;
+    fsimage_sector_track_clear(image);
 
-    offset = fsimage_gcr_seek_half_track(fsimage, half_track, &max_track_length, &num_half_tracks);
+    offset = fsimage_gcr_seek_half_track(image, half_track, &max_track_length, &num_half_tracks);
     if (offset < 0) {
         return -1;
     }
@@ -206,11 +203,8 @@ int fsimage_gcr_write_half_track(disk_image_t *image, unsigned int half_track,
     }
 
     if (offset == 0) {
-        offset = fseek(fsimage->fd, 0, SEEK_END);
-        if (offset == 0) {
-            offset = ftell(fsimage->fd);
-        }
-        if (offset < 0) {
+        offset = (long)fsimage_size(image);
+        if (offset <= 0) {
             log_error(fsimage_gcr_log, "Could not extend GCR disk image.");
             return -1;
         }
@@ -220,14 +214,14 @@ int fsimage_gcr_write_half_track(disk_image_t *image, unsigned int half_track,
     if (raw->data != NULL) {
         util_word_to_le_buf(buf, (uint16_t)raw->size);
 
-        if (util_fpwrite(fsimage->fd, buf, 2, offset) < 0) {
+        if (fsimage_pwrite(image, buf, 2, offset) < 0) {
             log_error(fsimage_gcr_log, "Could not write GCR disk image.");
             return -1;
         }
 
         /* Clear gap between the end of the actual track and the start of
            the next track.  */
-        if (fwrite(raw->data, raw->size, 1, fsimage->fd) < 1) {
+        if (fsimage_pwrite(image, raw->data, raw->size, offset + 2) < 0) {
             log_error(fsimage_gcr_log, "Could not write GCR disk image.");
             return -1;
         }
@@ -235,9 +229,9 @@ int fsimage_gcr_write_half_track(disk_image_t *image, unsigned int half_track,
 
         if (gap > 0) {
             uint8_t *padding = lib_calloc(1, gap);
-            res = fwrite(padding, gap, 1, fsimage->fd);
+            res = fsimage_pwrite(image, padding, gap, offset + 2 + raw->size);
             lib_free(padding);
-            if (res < 1) {
+            if (res < 0) {
                 log_error(fsimage_gcr_log, "Could not write GCR disk image.");
                 return -1;
             }
@@ -250,13 +244,13 @@ int fsimage_gcr_write_half_track(disk_image_t *image, unsigned int half_track,
              *        -- compyx 2020-07-24
              */
             util_dword_to_le_buf(buf, (uint32_t)offset);
-            if (util_fpwrite(fsimage->fd, buf, 4, 12 + (half_track - 2) * 4) < 0) {
+            if (fsimage_pwrite(image, buf, 4, 12 + (half_track - 2) * 4) < 0) {
                 log_error(fsimage_gcr_log, "Could not write GCR disk image.");
                 return -1;
             }
 
             util_dword_to_le_buf(buf, disk_image_speed_map(image->type, half_track / 2));
-            if (util_fpwrite(fsimage->fd, buf, 4, 12 + (half_track - 2 + num_half_tracks) * 4) < 0) {
+            if (fsimage_pwrite(image, buf, 4, 12 + (half_track - 2 + num_half_tracks) * 4) < 0) {
                 log_error(fsimage_gcr_log, "Could not write GCR disk image.");
                 return -1;
             }
@@ -264,7 +258,7 @@ int fsimage_gcr_write_half_track(disk_image_t *image, unsigned int half_track,
     }
 
     /* Make sure the stream is visible to other readers.  */
-    fflush(fsimage->fd);
+    fsimage_sync(image);
 
     return 0;
 }
@@ -290,16 +284,22 @@ int fsimage_gcr_read_sector(const disk_image_t *image, uint8_t *buf, const disk_
     }
 
     if (image->gcr == NULL) {
-        disk_track_t raw;
-        if (fsimage_gcr_read_track(image, dadr->track, &raw) < 0) {
-            return -1;
-        }
-        if (raw.data == NULL) {
-            return CBMDOS_IPE_NOT_READY;
+        fsimage_t *fsimage = image->media.fsimage;
+
+        if (fsimage->sector_track.track != dadr->track) {
+            disk_track_t raw;
+            if (fsimage_gcr_read_track(image, dadr->track, &raw) < 0) {
+                return -1;
+            }
+            if (raw.data == NULL) {
+                return CBMDOS_IPE_NOT_READY;
+            }
+            fsimage_sector_track_set(image, dadr->track, &raw);
         }
-        rf = gcr_read_sector(&raw, buf, (uint8_t)dadr->sector);
-        lib_free(raw.data);
+        rf = gcr_read_sector_indexed(&fsimage->sector_track.raw, &fsimage->sector_track.index,
+                                     buf, (uint8_t)dadr->sector);
     } else {
+        /* The drive writes this track in place, an index would go stale */
         rf = gcr_read_sector(&image->gcr->tracks[(dadr->track * 2) - 2], buf, (uint8_t)dadr->sector);
     }
     if (rf != CBMDOS_FDC_ERR_OK) {
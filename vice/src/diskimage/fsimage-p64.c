@@ -178,6 +178,7 @@ int fsimage_p64_write_half_track(disk_image_t *image, unsigned int half_track,
         return 0;
     }
 
+    fsimage_sector_track_clear(image);
     P64PulseStreamConvertFromGCR(&P64Image->PulseStreams[0][half_track], (void*)raw->data, raw->size << 3);
 
     return fsimage_write_p64_image(image);
@@ -200,6 +201,7 @@ static int fsimage_p64_write_track(disk_image_t *image, unsigned int track,
         return -1;
     }
 
+    fsimage_sector_track_clear(image);
     P64PulseStreamConvertFromGCR(&P64Image->PulseStreams[0][track << 1], (void*)gcr_track_start_ptr, gcr_track_size << 3);
 
     return fsimage_write_p64_image(image);
@@ -213,6 +215,7 @@ int fsimage_p64_read_sector(const disk_image_t *image, uint8_t *buf,
 {
     fdc_err_t rf;
     disk_track_t raw;
+    fsimage_t *fsimage = image->media.fsimage;
 
     if (dadr->track > 42) {
         log_error(fsimage_p64_log,
@@ -221,15 +224,29 @@ int fsimage_p64_read_sector(const disk_image_t *image, uint8_t *buf,
         return -1;
     }
 
-    if (fsimage_p64_read_track(image, dadr->track, &raw) < 0) {
-        return -1;
-    }
-    if (raw.data == NULL) {
-        return CBMDOS_IPE_NOT_READY;
+    if (image->gcr == NULL) {
+        if (fsimage->sector_track.track != dadr->track) {
+            if (fsimage_p64_read_track(image, dadr->track, &raw) < 0) {
+                return -1;
+            }
+            if (raw.data == NULL) {
+                return CBMDOS_IPE_NOT_READY;
+            }
+            fsimage_sector_track_set(image, dadr->track, &raw);
+        }
+        rf = gcr_read_sector_indexed(&fsimage->sector_track.raw, &fsimage->sector_track.index,
+                                     buf, (uint8_t)dadr->sector);
+    } else {
+        /* The drive writes the pulse streams in place, an index would go stale */
+        if (fsimage_p64_read_track(image, dadr->track, &raw) < 0) {
+            return -1;
+        }
+        if (raw.data == NULL) {
+            return CBMDOS_IPE_NOT_READY;
+        }
+        rf = gcr_read_sector(&raw, buf, (uint8_t)dadr->sector);
+        lib_free(raw.data);
     }
-
-    rf = gcr_read_sector(&raw, buf, (uint8_t)dadr->sector);
-    lib_free(raw.data);
     if (rf != CBMDOS_FDC_ERR_OK) {
         log_error(fsimage_p64_log,
                 "Cannot find track: %u sector: %u within P64 image.",
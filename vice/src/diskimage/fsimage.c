@@ -28,6 +28,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "archdep.h"
 #include "diskconstants.h"
@@ -39,6 +40,7 @@
 #include "fsimage.h"
 #include "lib.h"
 #include "log.h"
+#include "tick.h"
 #include "types.h"
 #include "zfile.h"
 #include "util.h"
@@ -122,6 +124,240 @@ void fsimage_media_destroy(disk_image_t *image)
 
 /*-----------------------------------------------------------------------*/
 
+/* Floppy sized images are kept in memory while attached: sector and track
+   accesses are served from there, writes are collected in a dirty bitmap and
+   reach the file on fsimage_flush().  CMD HD images are too large for this
+   and are also accessed through the file descriptor directly, P64 images are
+   read and written as a whole by their own code. */
+static int fsimage_cache_type(unsigned int type)
+{
+    switch (type) {
+        case DISK_IMAGE_TYPE_D64:
+        case DISK_IMAGE_TYPE_D67:
+        case DISK_IMAGE_TYPE_D71:
+        case DISK_IMAGE_TYPE_D81:
+        case DISK_IMAGE_TYPE_D80:
+        case DISK_IMAGE_TYPE_D82:
+#ifdef HAVE_X64_IMAGE
+        case DISK_IMAGE_TYPE_X64:
+#endif
+        case DISK_IMAGE_TYPE_D1M:
+        case DISK_IMAGE_TYPE_D2M:
+        case DISK_IMAGE_TYPE_D4M:
+        case DISK_IMAGE_TYPE_D90:
+        case DISK_IMAGE_TYPE_G64:
+        case DISK_IMAGE_TYPE_G71:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static size_t fsimage_cache_dirty_size(size_t len)
+{
+    return (len + FSIMAGE_CACHE_BLOCK * 8 - 1) / (FSIMAGE_CACHE_BLOCK * 8);
+}
+
+static void fsimage_cache_load(disk_image_t *image)
+{
+    fsimage_t *fsimage = image->media.fsimage;
+    size_t len;
+
+    if (!fsimage_cache_type(image->type)) {
+        return;
+    }
+
+    len = util_file_length(fsimage->fd);
+    if (len == 0) {
+        return;
+    }
+
+    fsimage->cache.data = lib_malloc(len);
+    if (util_fpread(fsimage->fd, fsimage->cache.data, len, 0) < 0) {
+        log_warning(fsimage_log, "Cannot cache `%s', accessing the file directly.", fsimage->name);
+        lib_free(fsimage->cache.data);
+        fsimage->cache.data = NULL;
+        return;
+    }
+    fsimage->cache.len = len;
+    fsimage->cache.dirty = lib_calloc(1, fsimage_cache_dirty_size(len));
+    fsimage->cache.dirty_any = 0;
+}
+
+static void fsimage_cache_free(fsimage_t *fsimage)
+{
+    lib_free(fsimage->cache.data);
+    lib_free(fsimage->cache.dirty);
+    fsimage->cache.data = NULL;
+    fsimage->cache.dirty = NULL;
+    fsimage->cache.len = 0;
+    fsimage->cache.dirty_any = 0;
+}
+
+/** \brief  Read bytes at a position of the image
+ *
+ * Same contract as util_fpread(), served from memory for cached images.
+ *
+ * \return  0 on success, -1 if the range is not within the image
+ */
+int fsimage_pread(const disk_image_t *image, void *buf, size_t num, long offset)
+{
+    fsimage_t *fsimage = image->media.fsimage;
+
+    if (fsimage->cache.data == NULL) {
+        return util_fpread(fsimage->fd, buf, num, offset);
+    }
+
+    if ((offset < 0) || ((size_t)offset > fsimage->cache.len)
+        || (num > fsimage->cache.len - (size_t)offset)) {
+        return -1;
+    }
+    memcpy(buf, fsimage->cache.data + offset, num);
+    return 0;
+}
+
+/** \brief  Write bytes at a position of the image
+ *
+ * Same contract as util_fpwrite().  For cached images the data is only
+ * written to memory, and the file grows on the next flush if the range is
+ * past its end.
+ *
+ * \return  0 on success, -1 on error
+ */
+int fsimage_pwrite(disk_image_t *image, const void *buf, size_t num, long offset)
+{
+    fsimage_t *fsimage = image->media.fsimage;
+    size_t block, first, end;
+
+    if (fsimage->cache.data == NULL) {
+        return util_fpwrite(fsimage->fd, buf, num, offset);
+    }
+
+    if ((offset < 0) || image->read_only) {
+        return -1;
+    }
+    if (num == 0) {
+        return 0;
+    }
+
+    first = (size_t)offset;
+    end = first + num;
+    if (end > fsimage->cache.len) {
+        size_t old_len = fsimage->cache.len;
+        size_t old_dirty = fsimage_cache_dirty_size(old_len);
+        size_t new_dirty = fsimage_cache_dirty_size(end);
+
+        fsimage->cache.data = lib_realloc(fsimage->cache.data, end);
+        memset(fsimage->cache.data + old_len, 0, end - old_len);
+        if (new_dirty > old_dirty) {
+            fsimage->cache.dirty = lib_realloc(fsimage->cache.dirty, new_dirty);
+            memset(fsimage->cache.dirty + old_dirty, 0, new_dirty - old_dirty);
+        }
+        fsimage->cache.len = end;
+        /* the zero filled gap up to the write has to reach the file too */
+        if (first > old_len) {
+            first = old_len;
+        }
+    }
+    memcpy(fsimage->cache.data + offset, buf, num);
+
+    for (block = first / FSIMAGE_CACHE_BLOCK; block <= (end - 1) / FSIMAGE_CACHE_BLOCK; block++) {
+        fsimage->cache.dirty[block >> 3] |= 1 << (block & 7);
+    }
+    if (!fsimage->cache.dirty_any) {
+        fsimage->cache.dirty_any = 1;
+        fsimage->cache.dirty_tick = tick_now();
+    }
+    return 0;
+}
+
+/** \brief  Write the blocks changed in the image cache back to the file
+ *
+ * \return  0 on success, -1 on error
+ */
+int fsimage_flush(disk_image_t *image)
+{
+    fsimage_t *fsimage = image->media.fsimage;
+    size_t block, first, blocks;
+    int res = 0;
+
+    if ((fsimage->cache.data == NULL) || !fsimage->cache.dirty_any) {
+        return 0;
+    }
+
+    blocks = (fsimage->cache.len + FSIMAGE_CACHE_BLOCK - 1) / FSIMAGE_CACHE_BLOCK;
+    for (block = 0; block < blocks; ) {
+        if (!(fsimage->cache.dirty[block >> 3] & (1 << (block & 7)))) {
+            block++;
+            continue;
+        }
+        /* write a run of dirty blocks at once */
+        for (first = block; (block < blocks) && (fsimage->cache.dirty[block >> 3] & (1 << (block & 7))); block++) {
+            fsimage->cache.dirty[block >> 3] &= ~(1 << (block & 7));
+        }
+        if (util_fpwrite(fsimage->fd, fsimage->cache.data + first * FSIMAGE_CACHE_BLOCK,
+                         (block * FSIMAGE_CACHE_BLOCK < fsimage->cache.len ? block * FSIMAGE_CACHE_BLOCK : fsimage->cache.len)
+                         - first * FSIMAGE_CACHE_BLOCK,
+                         (long)(first * FSIMAGE_CACHE_BLOCK)) < 0) {
+            res = -1;
+        }
+    }
+    fsimage->cache.dirty_any = 0;
+
+    if (res < 0) {
+        log_error(fsimage_log, "Cannot write back changes to `%s'.", fsimage->name);
+    }
+
+    /* Make sure the stream is visible to other readers.  */
+    fflush(fsimage->fd);
+    return res;
+}
+
+/** \brief  Write back the cache once its oldest unflushed write is due
+ *
+ * Called at every vsync, so a last write still reaches the file after
+ * FSIMAGE_CACHE_FLUSH_DELAY seconds when nothing else is written.
+ */
+void fsimage_flush_due(disk_image_t *image)
+{
+    fsimage_t *fsimage = image->media.fsimage;
+
+    if (fsimage->cache.dirty_any
+        && (tick_delta(fsimage->cache.dirty_tick) >= FSIMAGE_CACHE_FLUSH_DELAY * tick_per_second())) {
+        fsimage_flush(image);
+    }
+}
+
+/** \brief  Check for written data not in the file yet
+ *
+ * \return 1 while the image cache holds changes that were not flushed
+ */
+int fsimage_write_pending(const disk_image_t *image)
+{
+    const fsimage_t *fsimage = image->media.fsimage;
+
+    return fsimage->cache.dirty_any ? 1 : 0;
+}
+
+/** \brief  Make written data visible in the file
+ *
+ * Called after a write completes.  Uncached images are flushed right away,
+ * cached ones once the oldest unflushed write is FSIMAGE_CACHE_FLUSH_DELAY
+ * seconds old.
+ */
+void fsimage_sync(disk_image_t *image)
+{
+    fsimage_t *fsimage = image->media.fsimage;
+
+    if (fsimage->cache.data == NULL) {
+        fflush(fsimage->fd);
+    } else {
+        fsimage_flush_due(image);
+    }
+}
+
+/*-----------------------------------------------------------------------*/
+
 int fsimage_open(disk_image_t *image)
 {
     fsimage_t *fsimage;
@@ -147,6 +383,7 @@ int fsimage_open(disk_image_t *image)
     }
 
     if (fsimage_probe(image) == 0) {
+        fsimage_cache_load(image);
         return 0;
     }
 
@@ -170,6 +407,10 @@ int fsimage_close(disk_image_t *image)
         fsimage_write_p64_image(image);
     }*/
 
+    fsimage_flush(image);
+    fsimage_cache_free(fsimage);
+    fsimage_sector_track_clear(image);
+
     if (fsimage->error_info.map) {
         lib_free(fsimage->error_info.map);
         fsimage->error_info.map = NULL;
@@ -182,6 +423,31 @@ int fsimage_close(disk_image_t *image)
 
 /*-----------------------------------------------------------------------*/
 
+/* Sector reads of GCR and P64 images keep the raw track they decoded last,
+   with its sector index, so the other sectors of that track are read without
+   decoding and scanning it again.  The track writers clear it. */
+void fsimage_sector_track_set(const disk_image_t *image, unsigned int track, disk_track_t *raw)
+{
+    fsimage_t *fsimage = image->media.fsimage;
+
+    fsimage_sector_track_clear(image);
+    fsimage->sector_track.raw = *raw;
+    fsimage->sector_track.track = track;
+    gcr_index_track(&fsimage->sector_track.raw, &fsimage->sector_track.index);
+}
+
+void fsimage_sector_track_clear(const disk_image_t *image)
+{
+    fsimage_t *fsimage = image->media.fsimage;
+
+    lib_free(fsimage->sector_track.raw.data);
+    fsimage->sector_track.raw.data = NULL;
+    fsimage->sector_track.raw.size = 0;
+    fsimage->sector_track.track = 0;
+}
+
+/*-----------------------------------------------------------------------*/
+
 int fsimage_read_sector(const disk_image_t *image, uint8_t *buf, const disk_addr_t *dadr)
 {
     fsimage_t *fsimage;
@@ -289,5 +555,8 @@ uint32_t fsimage_size(const disk_image_t *image)
     fsimage_t *fsimage;
 
     fsimage = image->media.fsimage;
+    if (fsimage->cache.data != NULL) {
+        return (uint32_t)fsimage->cache.len;
+    }
     return (uint32_t)util_file_length(fsimage->fd);
 }
@@ -29,6 +29,7 @@
 
 #include <stdio.h>
 
+#include "gcr.h"
 #include "types.h"
 
 struct disk_image_s;
@@ -42,8 +43,26 @@ typedef struct fsimage_s {
         int dirty;
         int len;
     } error_info;
+    struct {
+        uint8_t *data;          /* whole image in memory, NULL if not cached */
+        size_t len;
+        uint8_t *dirty;         /* one bit per FSIMAGE_CACHE_BLOCK written since the last flush */
+        int dirty_any;
+        unsigned long dirty_tick;   /* tick_now() of the first unflushed write */
+    } cache;
+    struct {
+        disk_track_t raw;       /* track the last GCR sector read decoded */
+        unsigned int track;     /* 0 if none */
+        gcr_track_index_t index;
+    } sector_track;
 } fsimage_t;
 
+/* Granularity of the dirty tracking of the image cache */
+#define FSIMAGE_CACHE_BLOCK 256
+
+/* Seconds written data may stay in the image cache before a sync flushes it */
+#define FSIMAGE_CACHE_FLUSH_DELAY 2
+
 
 extern void fsimage_init(void);
 
@@ -61,4 +80,14 @@ extern int fsimage_write_sector(struct disk_image_s *image, const uint8_t *buf,
                                 const struct disk_addr_s *dadr);
 extern uint32_t fsimage_size(const disk_image_t *image);
 
+extern int fsimage_pread(const struct disk_image_s *image, void *buf, size_t num, long offset);
+extern int fsimage_pwrite(struct disk_image_s *image, const void *buf, size_t num, long offset);
+extern int fsimage_flush(struct disk_image_s *image);
+extern void fsimage_sync(struct disk_image_s *image);
+extern void fsimage_flush_due(struct disk_image_s *image);
+extern int fsimage_write_pending(const struct disk_image_s *image);
+
+extern void fsimage_sector_track_set(const struct disk_image_s *image, unsigned int track, disk_track_t *raw);
+extern void fsimage_sector_track_clear(const struct disk_image_s *image);
+
 #endif
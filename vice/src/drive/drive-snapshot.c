@@ -138,6 +138,11 @@ int drive_snapshot_write_module(snapshot_t *s, int save_disks, int save_roms)
     }
 #endif
 
+#ifdef __LIBRETRO__
+    /* A run-ahead checkpoint must not touch the disk, a track that is being
+       written goes back to the image once the drive leaves it */
+    if (!snapshot_is_checkpoint())
+#endif
     drive_gcr_data_writeback_all();
 
     /* TODO: drive 1? Is that loop for dual drives? or else?
@@ -331,6 +336,9 @@ int drive_snapshot_read_module(snapshot_t *s)
         return 0;
     }
 
+#ifdef __LIBRETRO__
+    if (!snapshot_is_checkpoint())
+#endif
     drive_gcr_data_writeback_all();
 
     /* reject snapshot modules newer than what we can handle (this VICE is too old) */
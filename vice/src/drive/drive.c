@@ -757,6 +757,31 @@ void drive_gcr_data_writeback_all(void)
     }
 }
 
+/* Return 1 while a drive is writing or has written data that has not
+   reached the image file yet. */
+int drive_write_pending(void)
+{
+    drive_t *drive;
+    unsigned int i, j;
+
+    if (!diskunit_context[0]) {
+        return 0;
+    }
+
+    for (i = 0; i < NUM_DISK_UNITS; i++) {
+        for (j = 0; j < NUM_DRIVES; j++) {
+            drive = diskunit_context[i]->drives[j];
+            if (drive && drive->image && !drive->read_only
+                && (drive->GCR_dirty_track || drive->P64_dirty
+                    || drive->read_write_mode == 0)) {
+                return 1;
+            }
+        }
+    }
+
+    return file_system_write_pending();
+}
+
 /* ------------------------------------------------------------------------- */
 
 static void drive_led_update(diskunit_context_t *unit, drive_t *drive, int base)
@@ -965,6 +990,7 @@ void drive_vsync_hook(void)
     unsigned int dnr;
 
     drive_update_ui_status();
+    file_system_vsync_hook();
 
     for (dnr = 0; dnr < NUM_DISK_UNITS; dnr++) {
         diskunit_context_t *unit = diskunit_context[dnr];
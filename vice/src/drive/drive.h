@@ -362,6 +362,7 @@ extern void drive_enable_update_ui(struct diskunit_context_s *drv);
 extern void drive_update_ui_status(void);
 extern void drive_gcr_data_writeback(struct drive_s *drive);
 extern void drive_gcr_data_writeback_all(void);
+extern int drive_write_pending(void);
 extern void drive_set_active_led_color(unsigned int type, unsigned int dnr);
 extern int drive_set_disk_drive_type(unsigned int drive_type,
                                      struct diskunit_context_s *drv);
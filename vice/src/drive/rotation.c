@@ -330,6 +330,186 @@ static void rotation_do_wobble(drive_t *dptr)
  * 1541 circuit simulation for GCR-based images (.g64),
  * see 1541 circuit description in this file for details
  ******************************************************************************/
+
+/* 8+2 bit shifter in read mode, clocked by the rising edge of UF4 stage B
+   at reference cycle `clk' */
+inline static void read_shift_bit(drive_t *dptr, rotation_t *rptr, uint32_t clk)
+{
+    /* UE5 NOR gate shifts in a 1 only at C2 when DC is 0 */
+    rptr->last_read_data = ((rptr->last_read_data << 1) & 0x3fe) | (((rptr->uf4_counter + 0x1c) >> 4) & 0x01);
+
+    rptr->write_flux = rptr->last_write_data & 0x80;
+    rptr->last_write_data <<= 1;
+
+    /* last 10 bits asserted activates SYNC, reloads UE3, negates BYTE READY */
+    if (rptr->last_read_data == 0x3ff) {
+        rptr->bit_counter = 0;
+        /* FIXME: code should take into account whether BYTE READY has been latched
+         * anywhere in the system or not and negate only the unlatched inputs.
+         * So we just leave it be for now
+         */
+    } else {
+        if (++rptr->bit_counter == 8) {
+            rptr->bit_counter = 0;
+            dptr->GCR_read = (uint8_t) rptr->last_read_data;
+            rptr->last_write_data = dptr->GCR_read;
+
+            /* BYTE READY signal if enabled */
+            if ((dptr->byte_ready_active & BRA_BYTE_READY) != 0) {
+                rptr->so_delay = 16 - (clk & 15);
+                if (rptr->so_delay < 10) {
+                    rptr->so_delay += 16;
+                }
+            }
+        }
+    }
+}
+
+/* Fast forward the read circuit from one event to the next.  Between events
+ * the passes of the loop in rotation_1541_gcr() only count: UE7 carries that
+ * do not clock the shifter, bitcells that read a zero, the countdown of the
+ * random flux and SO counters.  Those are jumped over in one go, stopping on
+ * the next shifter edge, bitcell, flux reversal or SO edge.  A flux reversal
+ * reloads UE7 with the length of the pass it ends, so the start of that pass
+ * is reconstructed from the pass boundaries the loop would have used.  The
+ * result is identical to stepping the loop.  Returns the reference cycles
+ * left when the state is one the loop has to handle itself.
+ */
+static int rotation_1541_gcr_read_skip(drive_t *dptr, rotation_t *rptr,
+                                       uint32_t count_new_bitcell, uint32_t cyc_sum_frv,
+                                       int ref_cycles)
+{
+    uint32_t period = 16 - rptr->ue7_dcba;
+    uint32_t ue7_counter = rptr->ue7_counter;
+    uint32_t uf4_counter = rptr->uf4_counter;
+    uint32_t fr_randcount = rptr->fr_randcount;
+    uint32_t accum = rptr->accum;
+    uint32_t cycle_index = rptr->cycle_index;
+    int filter_counter = rptr->filter_counter;
+    uint32_t delta, t_star = 0, t_cross = 0;
+    int bitcell = 0;
+
+    while (ref_cycles > 0) {
+        uint32_t t, t_carry, t_shift, carries, last_carry, last;
+
+        if ((ue7_counter >= 16) || (accum >= count_new_bitcell)
+            || ((filter_counter < 40) ? (filter_counter < 39)
+                : (rptr->filter_last_state != rptr->filter_state))) {
+            break;
+        }
+
+        /* reference cycles until the next UE7 carry and the next shifter edge */
+        t_carry = 16 - ue7_counter;
+        t_shift = t_carry + ((1 - uf4_counter) & 3) * period;
+
+        /* the last pass before a bitcell ends at t_star, the bitcell is read at t_cross */
+        if (!bitcell) {
+            delta = count_new_bitcell - accum;
+            t_star = delta / cyc_sum_frv;
+            t_cross = t_star + ((delta % cyc_sum_frv) ? 1 : 0);
+            bitcell = 1;
+        }
+
+        t = (uint32_t)ref_cycles;
+        if (filter_counter < 40) {
+            /* the flux filter settles in the next cycle */
+            t = 1;
+        }
+        if (t_shift < t) {
+            t = t_shift;
+        }
+        if (t_cross < t) {
+            t = t_cross;
+        }
+        if ((fr_randcount > 0) && (fr_randcount < t)) {
+            t = fr_randcount;
+        }
+        if ((rptr->so_delay > 0) && ((uint32_t)rptr->so_delay < t)) {
+            t = rptr->so_delay;
+        }
+
+        /* UE7 carries before t, and the last pass boundary before t */
+        carries = 0;
+        last_carry = 0;
+        while (t_carry < t) {
+            last_carry = t_carry;
+            t_carry += period;
+            carries++;
+        }
+        last = last_carry;
+        if ((t_star < t) && (t_star > last)) {
+            last = t_star;
+        }
+
+        /* so signal handling */
+        if (rptr->so_delay) {
+            rptr->so_delay -= t;
+            if (!rptr->so_delay) {
+                dptr->byte_ready_edge = 1;
+                dptr->byte_ready_level = 1;
+            }
+        }
+
+        filter_counter += t;
+        if ((filter_counter >= 40) && (rptr->filter_last_state != rptr->filter_state)) {
+            rptr->filter_last_state = rptr->filter_state;
+            fr_randcount = ((RANDOM_nextUInt(rptr) >> 16) % 31) + 289;
+            t_carry = 0;
+        } else {
+            fr_randcount -= t;
+            if (!fr_randcount) {
+                fr_randcount = ((RANDOM_nextUInt(rptr) >> 16) % 367) + 33;
+                t_carry = 0;
+            }
+        }
+
+        if (!t_carry) {
+            /* flux reversal, UE7 counts on for the pass that ends here */
+            ue7_counter = rptr->ue7_dcba + (t - last);
+            uf4_counter = 0;
+            if (ue7_counter == 16) {
+                ue7_counter = rptr->ue7_dcba;
+                uf4_counter = 1;
+            }
+        } else if (t_carry == t) {
+            ue7_counter = rptr->ue7_dcba;
+            uf4_counter = (uf4_counter + carries + 1) & 0xf;
+            if (t == t_shift) {
+                rptr->uf4_counter = uf4_counter;
+                read_shift_bit(dptr, rptr, cycle_index + (t - 1));
+            }
+        } else {
+            ue7_counter = carries ? rptr->ue7_dcba + (t - last_carry) : ue7_counter + t;
+            uf4_counter = (uf4_counter + carries) & 0xf;
+        }
+
+        accum += cyc_sum_frv * t;
+        if (t == t_cross) {
+            accum -= count_new_bitcell;
+            bitcell = 0;
+            if (read_next_bit(dptr)) {
+                filter_counter = 39;
+                rptr->filter_state = rptr->filter_state ^ 1;
+            }
+        } else {
+            t_cross -= t;
+            t_star -= t;
+        }
+
+        cycle_index += t;
+        ref_cycles -= t;
+    }
+
+    rptr->ue7_counter = (int)ue7_counter;
+    rptr->uf4_counter = (int)uf4_counter;
+    rptr->fr_randcount = fr_randcount;
+    rptr->accum = accum;
+    rptr->cycle_index = cycle_index;
+    rptr->filter_counter = filter_counter;
+
+    return ref_cycles;
+}
+
 static void rotation_1541_gcr(drive_t *dptr, int ref_cycles)
 {
     rotation_t *rptr;
@@ -373,6 +553,11 @@ static void rotation_1541_gcr(drive_t *dptr, int ref_cycles)
     if (dptr->read_write_mode) {
         /* emulate the number of reference clocks requested */
         while (ref_cycles > 0) {
+            ref_cycles = rotation_1541_gcr_read_skip(dptr, rptr, count_new_bitcell, cyc_sum_frv, ref_cycles);
+            if (ref_cycles <= 0) {
+                break;
+            }
+
             /* calculate how much cycles can we do in one single pass */
             todo = 1;
             delta = count_new_bitcell - rptr->accum;
@@ -435,36 +620,7 @@ static void rotation_1541_gcr(drive_t *dptr, int ref_cycles)
 
                 /* the rising edge of UF4 stage B drives the shifter */
                 if ((rptr->uf4_counter & 0x3) == 2) {
-                    /* 8+2 bit shifter */
-
-                    /* UE5 NOR gate shifts in a 1 only at C2 when DC is 0 */
-                    rptr->last_read_data = ((rptr->last_read_data << 1) & 0x3fe) | (((rptr->uf4_counter + 0x1c) >> 4) & 0x01);
-
-                    rptr->write_flux = rptr->last_write_data & 0x80;
-                    rptr->last_write_data <<= 1;
-
-                    /* last 10 bits asserted activates SYNC, reloads UE3, negates BYTE READY */
-                    if (rptr->last_read_data == 0x3ff) {
-                        rptr->bit_counter = 0;
-                        /* FIXME: code should take into account whether BYTE READY has been latched
-                         * anywhere in the system or not and negate only the unlatched inputs.
-                         * So we just leave it be for now
-                         */
-                    } else {
-                        if (++rptr->bit_counter == 8) {
-                            rptr->bit_counter = 0;
-                            dptr->GCR_read = (uint8_t) rptr->last_read_data;
-                            rptr->last_write_data = dptr->GCR_read;
-
-                            /* BYTE READY signal if enabled */
-                            if ((dptr->byte_ready_active & BRA_BYTE_READY) != 0) {
-                                rptr->so_delay = 16 - ((rptr->cycle_index + (todo - 1)) & 15);
-                                if (rptr->so_delay < 10) {
-                                    rptr->so_delay += 16;
-                                }
-                            }
-                        }
-                    }
+                    read_shift_bit(dptr, rptr, rptr->cycle_index + (todo - 1));
                 }
             }
 
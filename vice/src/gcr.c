@@ -167,36 +167,51 @@ void gcr_convert_sector_to_GCR(const uint8_t *buffer, uint8_t *data, const gcr_h
     gcr_convert_4bytes_to_GCR(buf, data);
 }
 
+/* Find the end of the next SYNC mark (10 or more 1 bits) within `s' bits
+   starting at bit `p', and return the bit offset of the 0 bit ending it.
+   Whole bytes are taken at once, a SYNC can only end inside a byte at its
+   leading run of 1 bits. */
 static int gcr_find_sync(const disk_track_t *raw, int p, int s)
 {
-    unsigned int w;
-    int b;
+    int ones, b, n;
 
     if (!raw->data || !raw->size) {
         return -CBMDOS_FDC_ERR_SYNC;
     }
 
-    w = 0;
-    b = raw->data[p >> 3] << (p & 7);
-    while (s--) {
-        if (b & 0x80) {
-            w = (w << 1) | 1;
-        } else {
-            if (~w & 0x3ff) {
-                w <<= 1;
+    ones = 0;
+    while (s > 0) {
+        b = raw->data[p >> 3];
+        if (((p & 7) == 0) && (s >= 8)) {
+            if (b == 0xff) {
+                ones += 8;
             } else {
-                return p;
+                /* leading 1 bits, then the first 0 bit */
+                for (n = 0; b & (0x80 >> n); n++) {
+                }
+                if (ones + n >= 10) {
+                    return p + n;
+                }
+                /* trailing 1 bits carry over into the next byte */
+                for (ones = 0; b & (1 << ones); ones++) {
+                }
             }
-        }
-        if (~p & 7) {
-            p++;
-            b <<= 1;
+            p += 8;
+            s -= 8;
         } else {
-            p++;
-            if (p >= raw->size * 8) {
-                p = 0;
+            if (b & (0x80 >> (p & 7))) {
+                ones++;
+            } else {
+                if (ones >= 10) {
+                    return p;
+                }
+                ones = 0;
             }
-            b = raw->data[p >> 3];
+            p++;
+            s--;
+        }
+        if (p >= raw->size * 8) {
+            p = 0;
         }
     }
     return -CBMDOS_FDC_ERR_SYNC;
@@ -260,21 +275,44 @@ static int gcr_find_sector_header(const disk_track_t *raw, uint8_t sector)
     return -CBMDOS_FDC_ERR_HEADER;
 }
 
-fdc_err_t gcr_read_sector(const disk_track_t *raw, uint8_t *data, uint8_t sector)
+void gcr_index_track(const disk_track_t *raw, gcr_track_index_t *index)
 {
-    uint8_t buffer[260];
-    uint8_t b;
-    int i, p;
+    uint8_t header[4], found[256];
+    int i, p, p2;
 
-    p = gcr_find_sector_header(raw, sector);
-    if (p < 0) {
-        return -p;
+    memset(found, 0, sizeof(found));
+
+    /* same walk as gcr_find_sector_header(), keeping the first hit of each sector */
+    p = 0;
+    p2 = -CBMDOS_FDC_ERR_SYNC;
+    for (;; ) {
+        p = gcr_find_sync(raw, p, raw->size * 8);
+        if (p2 == p) {
+            break;
+        }
+        if (p2 < 0) {
+            p2 = p;
+        }
+        gcr_decode_block(raw, p, header, 1);
+
+        if (header[0] == 0x08 && !found[header[2]]) {
+            found[header[2]] = 1;
+            index->data[header[2]] = gcr_find_sync(raw, p, 500 * 8);
+        }
     }
 
-    p = gcr_find_sync(raw, p, 500 * 8);
-    if (p < 0) {
-        return -p;
+    for (i = 0; i < 256; i++) {
+        if (!found[i]) {
+            index->data[i] = (p2 < 0) ? p2 : -CBMDOS_FDC_ERR_HEADER;
+        }
     }
+}
+
+static fdc_err_t gcr_read_sector_data(const disk_track_t *raw, int p, uint8_t *data)
+{
+    uint8_t buffer[260];
+    uint8_t b;
+    int i;
 
     gcr_decode_block(raw, p, buffer, 65);
 
@@ -291,6 +329,35 @@ fdc_err_t gcr_read_sector(const disk_track_t *raw, uint8_t *data, uint8_t sector
     return b ? CBMDOS_FDC_ERR_DCHECK : CBMDOS_FDC_ERR_OK;
 }
 
+fdc_err_t gcr_read_sector(const disk_track_t *raw, uint8_t *data, uint8_t sector)
+{
+    int p;
+
+    p = gcr_find_sector_header(raw, sector);
+    if (p < 0) {
+        return -p;
+    }
+
+    p = gcr_find_sync(raw, p, 500 * 8);
+    if (p < 0) {
+        return -p;
+    }
+
+    return gcr_read_sector_data(raw, p, data);
+}
+
+fdc_err_t gcr_read_sector_indexed(const disk_track_t *raw, const gcr_track_index_t *index,
+                                  uint8_t *data, uint8_t sector)
+{
+    int p = index->data[sector];
+
+    if (p < 0) {
+        return -p;
+    }
+
+    return gcr_read_sector_data(raw, p, data);
+}
+
 fdc_err_t gcr_write_sector(disk_track_t *raw, const uint8_t *data, uint8_t sector)
 {
     uint8_t buffer[260], *offset, *buf;
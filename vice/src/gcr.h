@@ -58,6 +58,13 @@ typedef struct gcr_s {
     disk_track_t tracks[MAX_GCR_TRACKS];
 } gcr_t;
 
+/* Bit offsets of the data block following the first header of every sector
+   number in a raw track, or the negated FDC error for sectors that were not
+   found. Only valid until the track is written. */
+typedef struct gcr_track_index_s {
+    int data[256];
+} gcr_track_index_t;
+
 typedef struct gcr_header_s {
     uint8_t sector, track, id2, id1;
 } gcr_header_t;
@@ -65,6 +72,9 @@ typedef struct gcr_header_s {
 extern void gcr_convert_sector_to_GCR(const uint8_t *buffer, uint8_t *ptr, const gcr_header_t *header,
                                       int gap, int sync, enum fdc_err_e error_code);
 extern enum fdc_err_e gcr_read_sector(const disk_track_t *raw, uint8_t *data, uint8_t sector);
+extern void gcr_index_track(const disk_track_t *raw, gcr_track_index_t *index);
+extern enum fdc_err_e gcr_read_sector_indexed(const disk_track_t *raw, const gcr_track_index_t *index,
+                                              uint8_t *data, uint8_t sector);
 extern enum fdc_err_e gcr_write_sector(disk_track_t *raw, const uint8_t *data, uint8_t sector);
 
 extern gcr_t *gcr_create_image(void);
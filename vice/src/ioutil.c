@@ -69,6 +69,10 @@
 #include "util.h"
 #include "vicemaxpath.h"
 
+#ifdef __LIBRETRO__
+#include "libretro-memvfs.h"
+#endif
+
 /* Mostly POSIX compatibily */
 
 int ioutil_access(const char *pathname, int mode)
@@ -88,6 +92,13 @@ int ioutil_access(const char *pathname, int mode)
         access_mode |= ARCHDEP_F_OK;
     }
 
+#ifdef __LIBRETRO__
+    /* Files in the memory backed temp directory are always accessible */
+    if (memvfs_contains(pathname)) {
+        return 0;
+    }
+#endif
+
     return access(pathname, access_mode);
 }
 
@@ -171,6 +182,11 @@ int ioutil_mkdir(const char *pathname, int mode)
 
 int ioutil_remove(const char *name)
 {
+#ifdef __LIBRETRO__
+    if (memvfs_contains(name)) {
+        return memvfs_remove(name);
+    }
+#endif
     return unlink(name);
 }
 
@@ -74,4 +74,13 @@ extern unsigned int maincpu_get_x(void);
 extern unsigned int maincpu_get_y(void);
 extern unsigned int maincpu_get_sp(void);
 
+#ifdef __LIBRETRO__
+/* The CPU loop runs until the frame ends (retro_renderloop cleared by
+   vsync) or until a trap asks to leave (maincpu_loop_exit_pending), keeping
+   its registers in locals. They are imported before the first instruction
+   and exported when the loop is left. */
+extern unsigned int retro_renderloop;
+extern int maincpu_loop_exit_pending;
+#endif
+
 #endif
@@ -460,19 +460,21 @@ void maincpu_resync_limits(void)
 }
 
 #ifdef __LIBRETRO__
+int maincpu_loop_exit_pending = 0;
+
 void maincpu_mainloop(void)
 {
 #ifndef C64DTV
     /* Notice that using a struct for these would make it a lot slower (at
        least, on gcc 2.7.2.x).  */
-    static uint8_t reg_a = 0;
-    static uint8_t reg_x = 0;
-    static uint8_t reg_y = 0;
+    uint8_t reg_a = 0;
+    uint8_t reg_x = 0;
+    uint8_t reg_y = 0;
 #else
-    static int reg_a_read_idx = 0;
-    static int reg_a_write_idx = 0;
-    static int reg_x_idx = 2;
-    static int reg_y_idx = 1;
+    int reg_a_read_idx = 0;
+    int reg_a_write_idx = 0;
+    int reg_x_idx = 2;
+    int reg_y_idx = 1;
 
 #define reg_a_write(c)                      \
     do {                                    \
@@ -500,12 +502,12 @@ void maincpu_mainloop(void)
     } while (0);
 #define reg_y_read dtv_registers[reg_y_idx]
 #endif
-    static uint8_t reg_p = 0;
-    static uint8_t reg_sp = 0;
-    static uint8_t flag_n = 0;
-    static uint8_t flag_z = 0;
+    uint8_t reg_p = 0;
+    uint8_t reg_sp = 0;
+    uint8_t flag_n = 0;
+    uint8_t flag_z = 0;
 #ifndef NEED_REG_PC
-    static unsigned int reg_pc;
+    unsigned int reg_pc;
 #endif
 
 static unsigned retro_mainloop = 0;
@@ -521,8 +523,19 @@ if (!retro_mainloop)
     bank_base_ready = true;
 
     machine_trigger_reset(MACHINE_RESET_MODE_SOFT);
+
+    /* Called once from main_loop_forever() while initializing, return after
+       the first instruction and leave the frames to retro_run() */
+    maincpu_loop_exit_pending = 1;
+}
+else
+{
+    /* Registers may have changed while outside of the loop. The core
+       included below defines IMPORT_REGISTERS(), so jump to its use at the
+       end of the loop body once before the first instruction. */
+    goto import_registers;
 }
-    /*while (1)*/ {
+    while (1) {
 #define CLK maincpu_clk
 #define RMW_FLAG maincpu_rmw_flag
 #define LAST_OPCODE_INFO last_opcode_info
@@ -583,7 +596,18 @@ if (!retro_mainloop)
             debug.maincpu_traceflg = 1;
         }
 #endif
+
+        /* Frame done or trap asked to leave, publish the registers */
+        if (!retro_renderloop || maincpu_loop_exit_pending) {
+            EXPORT_REGISTERS();
+            break;
+        }
+        continue;
+
+import_registers:
+        IMPORT_REGISTERS();
     }
+    maincpu_loop_exit_pending = 0;
 }
 
 #else /* __LIBRETRO__ */
@@ -38,6 +38,7 @@
 #include "machine.h"
 #include "monitor.h"
 #include "resources.h"
+#include "snapshot.h"
 #include "sysfile.h"
 
 /* #define DEBUGCART */
@@ -288,6 +289,10 @@ void plus4cart_detach_cartridges(void)
 
 void cartridge_detach_image(int type)
 {
+#ifdef __LIBRETRO__
+    snapshot_size_invalidate();
+#endif
+
     if (type < 0) {
         plus4cart_detach_cartridges();
     } else {
@@ -377,6 +382,10 @@ static int cart_load_generic(int type, const char *filename)
 
 int cartridge_attach_image(int type, const char *filename)
 {
+#ifdef __LIBRETRO__
+    snapshot_size_invalidate();
+#endif
+
     if (type == CARTRIDGE_PLUS4_DETECT) {
         type = cartridge_detect(filename);
     }
@@ -0,0 +1,130 @@
+//  ---------------------------------------------------------------------------
+//  This file is part of reSID, a MOS6581 SID emulator engine.
+//  Copyright (C) 2010  Dag Lem <resid@nimrod.no>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//  ---------------------------------------------------------------------------
+
+#ifndef RESID_CONVOLVE_H
+#define RESID_CONVOLVE_H
+
+// FIR convolution kernels for the resamplers of both reSID and reSIDfp.
+// The vector paths sum 16 bit products pairwise into 32 bit lanes, which
+// wraps exactly like the scalar loop, so every path gives identical results.
+// AVX2 is picked at runtime, SSE2 and NEON are used when the target has them.
+// The kernel is picked once when a resampler is set up and kept with it, so
+// the audio threads only ever call through it.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CONVOLVE_SSE2
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#include <immintrin.h>
+#define CONVOLVE_AVX2
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CONVOLVE_NEON
+#endif
+
+typedef int (*convolve_func_t)(const short* a, const short* b, int n);
+
+static inline int convolve_scalar(const short* a, const short* b, int n)
+{
+  int v = 0;
+  for (int i = 0; i < n; i++) {
+    v += a[i]*b[i];
+  }
+  return v;
+}
+
+#ifdef CONVOLVE_SSE2
+static inline int convolve_sse2(const short* a, const short* b, int n)
+{
+  __m128i acc = _mm_setzero_si128();
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(x, y));
+  }
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+
+  return _mm_cvtsi128_si32(acc) + convolve_scalar(a + i, b + i, n - i);
+}
+#endif
+
+#ifdef CONVOLVE_AVX2
+__attribute__((target("avx2")))
+static int convolve_avx2(const short* a, const short* b, int n)
+{
+  __m256i acc = _mm256_setzero_si256();
+  __m128i sum;
+  int i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+    __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(x, y));
+  }
+  sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+  return _mm_cvtsi128_si32(sum) + convolve_sse2(a + i, b + i, n - i);
+}
+#endif
+
+#ifdef CONVOLVE_NEON
+static inline int convolve_neon(const short* a, const short* b, int n)
+{
+  int32x4_t acc = vdupq_n_s32(0);
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t x = vld1q_s16(a + i);
+    int16x8_t y = vld1q_s16(b + i);
+    acc = vmlal_s16(acc, vget_low_s16(x), vget_low_s16(y));
+    acc = vmlal_s16(acc, vget_high_s16(x), vget_high_s16(y));
+  }
+
+  return vgetq_lane_s32(acc, 0) + vgetq_lane_s32(acc, 1)
+       + vgetq_lane_s32(acc, 2) + vgetq_lane_s32(acc, 3)
+       + convolve_scalar(a + i, b + i, n - i);
+}
+#endif
+
+// Kernel for this CPU, each returns the sum of a[i]*b[i] for i in [0, n),
+// modulo 2^32.
+static inline convolve_func_t convolve_select()
+{
+#if defined(CONVOLVE_AVX2)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return convolve_avx2;
+  }
+#endif
+#if defined(CONVOLVE_SSE2)
+  return convolve_sse2;
+#elif defined(CONVOLVE_NEON)
+  return convolve_neon;
+#else
+  return convolve_scalar;
+#endif
+}
+
+#endif // not RESID_CONVOLVE_H
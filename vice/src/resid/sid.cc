@@ -25,6 +25,7 @@
 #endif
 
 #include "sid.h"
+#include "convolve.h"
 #include <math.h>
 
 #ifndef round
@@ -59,6 +60,7 @@ SID::SID()
   fir_beta = 0;
   fir_f_cycles_per_sample = 0;
   fir_filter_scale = 0;
+  fir_convolve = convolve_select();
 
   sid_model = MOS6581;
   voice[0].set_sync_source(&voice[2]);
@@ -872,6 +874,81 @@ int SID::clock_interpolate(cycle_count& delta_t, short* buf, int n, int interlea
 }
 
 
+// ----------------------------------------------------------------------------
+// SID clocking into the sample ring buffer, one sample per cycle.
+// When no voice is synced or ring modulated the voices are independent, and
+// each envelope and oscillator is stepped over the whole span in its own
+// loop before the filters are run per cycle. The result is identical to
+// stepping all components cycle by cycle.
+// ----------------------------------------------------------------------------
+void SID::clock_samples(cycle_count delta_t, bool clipped)
+{
+  int voice_output[3][CLOCK_BLOCK];
+  short envelope_output[CLOCK_BLOCK];
+  int i, k;
+
+  // Pipelined writes on the MOS8580 happen in the first cycle.
+  if (unlikely(write_pipeline) && likely(delta_t > 0)) {
+    clock();
+    sample[sample_index] = sample[sample_index + RINGSIZE] = clipped ? clip(output()) : output();
+    ++sample_index &= RINGMASK;
+    delta_t--;
+  }
+
+  for (i = 0; i < 3; i++) {
+    WaveformGenerator& wave = voice[i].wave;
+    if (unlikely(wave.sync || wave.ring_msb_mask)) {
+      break;
+    }
+  }
+
+  if (i < 3) {
+    for (k = 0; k < delta_t; k++) {
+      clock();
+      sample[sample_index] = sample[sample_index + RINGSIZE] = clipped ? clip(output()) : output();
+      ++sample_index &= RINGMASK;
+    }
+    return;
+  }
+
+  while (delta_t > 0) {
+    cycle_count n = delta_t < CLOCK_BLOCK ? delta_t : CLOCK_BLOCK;
+
+    for (i = 0; i < 3; i++) {
+      EnvelopeGenerator& envelope = voice[i].envelope;
+      WaveformGenerator& wave = voice[i].wave;
+      short wave_zero = voice[i].wave_zero;
+
+      for (k = 0; k < n; k++) {
+        envelope.clock();
+        envelope_output[k] = envelope.output();
+      }
+
+      for (k = 0; k < n; k++) {
+        wave.clock();
+        wave.set_waveform_output();
+        voice_output[i][k] = (wave.output() - wave_zero)*envelope_output[k];
+      }
+    }
+
+    for (k = 0; k < n; k++) {
+      filter.clock(voice_output[0][k], voice_output[1][k], voice_output[2][k]);
+      extfilt.clock(filter.output());
+      sample[sample_index] = sample[sample_index + RINGSIZE] = clipped ? clip(output()) : output();
+      ++sample_index &= RINGMASK;
+    }
+
+    // Age bus value.
+    if (bus_value_ttl > 0 && bus_value_ttl <= n) {
+      bus_value = 0;
+    }
+    bus_value_ttl -= n;
+
+    delta_t -= n;
+  }
+}
+
+
 // ----------------------------------------------------------------------------
 // SID clocking with audio sampling - cycle based with audio resampling.
 //
@@ -920,11 +997,7 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
       delta_t_sample = delta_t;
     }
 
-    for (int i = 0; i < delta_t_sample; i++) {
-      clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = clip(output());
-      ++sample_index &= RINGMASK;
-    }
+    clock_samples(delta_t_sample, true);
 
     if ((delta_t -= delta_t_sample) == 0) {
       sample_offset -= delta_t_sample << FIXP_SHIFT;
@@ -939,10 +1012,7 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
     short* sample_start = sample + sample_index - fir_N - 1 + RINGSIZE;
 
     // Convolution with filter impulse response.
-    int v1 = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v1 += sample_start[j]*fir_start[j];
-    }
+    int v1 = fir_convolve(sample_start, fir_start, fir_N);
 
     // Use next FIR table, wrap around to first FIR table using
     // next sample.
@@ -953,10 +1023,7 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
     fir_start = fir + fir_offset*fir_N;
 
     // Convolution with filter impulse response.
-    int v2 = 0;
-    for (int k = 0; k < fir_N; k++) {
-      v2 += sample_start[k]*fir_start[k];
-    }
+    int v2 = fir_convolve(sample_start, fir_start, fir_N);
 
     // Linear interpolation.
     // fir_offset_rmd is equal for all samples, it can thus be factorized out:
@@ -987,11 +1054,7 @@ int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n, int int
       delta_t_sample = delta_t;
     }
 
-    for (int i = 0; i < delta_t_sample; i++) {
-      clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = output();
-      ++sample_index &= RINGMASK;
-    }
+    clock_samples(delta_t_sample, false);
 
     if ((delta_t -= delta_t_sample) == 0) {
       sample_offset -= delta_t_sample << FIXP_SHIFT;
@@ -1005,10 +1068,7 @@ int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n, int int
     short* sample_start = sample + sample_index - fir_N + RINGSIZE;
 
     // Convolution with filter impulse response.
-    int v = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v += sample_start[j]*fir_start[j];
-    }
+    int v = fir_convolve(sample_start, fir_start, fir_N);
 
     v >>= FIR_SHIFT;
 
@@ -106,6 +106,7 @@ public:
   int clock_interpolate(cycle_count& delta_t, short* buf, int n, int interleave);
   int clock_resample(cycle_count& delta_t, short* buf, int n, int interleave);
   int clock_resample_fastmem(cycle_count& delta_t, short* buf, int n, int interleave);
+  void clock_samples(cycle_count delta_t, bool clipped);
   void write();
 
   chip_model sid_model;
@@ -143,6 +144,9 @@ public:
     RINGSIZE = 1 << 14,
     RINGMASK = RINGSIZE - 1,
 
+    // Cycles per pass of component wise clocking.
+    CLOCK_BLOCK = 64,
+
     // Fixed point constants (16.16 bits).
     FIXP_SHIFT = 16,
     FIXP_MASK = 0xffff
@@ -165,6 +169,9 @@ public:
 
   // FIR_RES filter tables (FIR_N*FIR_RES).
   short* fir;
+
+  // FIR convolution kernel for this CPU, see convolve.h.
+  int (*fir_convolve)(const short* a, const short* b, int n);
 };
 
 
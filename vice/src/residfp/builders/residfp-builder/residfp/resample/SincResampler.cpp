@@ -42,6 +42,7 @@
 #endif
 
 #ifdef __LIBRETRO__
+#include "convolve.h"
 #else
 #ifdef HAVE_MMINTRIN_H
 #  include <mmintrin.h>
@@ -88,6 +89,21 @@ double I0(double x)
     return sum;
 }
 
+#ifdef __LIBRETRO__
+/**
+ * Calculate convolution with sample and sinc.
+ *
+ * @param kernel convolution kernel
+ * @param a sample buffer input
+ * @param b sinc buffer
+ * @param bLength length of the sinc buffer
+ * @return convolved result
+ */
+int convolve(convolve_func_t kernel, const short* a, const short* b, int bLength)
+{
+    return (kernel(a, b, bLength) + (1 << 14)) >> 15;
+}
+#else
 /**
  * Calculate convolution with sample and sinc.
  *
@@ -126,6 +142,7 @@ int convolve(const short* a, const short* b, int bLength)
 
     return (out + (1 << 14)) >> 15;
 }
+#endif
 
 int SincResampler::fir(int subcycle)
 {
@@ -136,7 +153,11 @@ int SincResampler::fir(int subcycle)
     // Find firN most recent samples, plus one extra in case the FIR wraps.
     int sampleStart = sampleIndex - firN + RINGSIZE - 1;
 
+#ifdef __LIBRETRO__
+    const int v1 = convolve(firConvolve, sample + sampleStart, (*firTable)[firTableFirst], firN);
+#else
     const int v1 = convolve(sample + sampleStart, (*firTable)[firTableFirst], firN);
+#endif
 
     // Use next FIR table, wrap around to first FIR table using
     // previous sample.
@@ -146,7 +167,11 @@ int SincResampler::fir(int subcycle)
         ++sampleStart;
     }
 
+#ifdef __LIBRETRO__
+    const int v2 = convolve(firConvolve, sample + sampleStart, (*firTable)[firTableFirst], firN);
+#else
     const int v2 = convolve(sample + sampleStart, (*firTable)[firTableFirst], firN);
+#endif
 
     // Linear interpolation between the sinc tables yields good
     // approximation for the exact value.
@@ -159,6 +184,10 @@ SincResampler::SincResampler(double clockFrequency, double samplingFrequency, do
     sampleOffset(0),
     outputValue(0)
 {
+#ifdef __LIBRETRO__
+    firConvolve = convolve_select();
+#endif
+
     // 16 bits -> -96dB stopband attenuation.
     const double A = -20. * log10(1.0 / (1 << BITS));
     // A fraction of the bandwidth is allocated to the transition band, which we double
@@ -82,6 +82,11 @@ private:
 
     short sample[RINGSIZE * 2];
 
+#ifdef __LIBRETRO__
+    /// FIR convolution kernel for this CPU, see convolve.h
+    int (*firConvolve)(const short* a, const short* b, int n);
+#endif
+
 private:
     int fir(int subcycle);
 
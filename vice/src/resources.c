@@ -57,6 +57,10 @@
 #include "util.h"
 #include "vice-event.h"
 
+#ifdef __LIBRETRO__
+#include "snapshot.h"
+#endif
+
 #ifdef VICE_DEBUG_RESOURCES
 #define DBG(x)  printf x
 #else
@@ -103,6 +107,11 @@ typedef struct resource_ram_s {
 
     /* number of next entry in hash collision list */
     int hash_next;
+
+#ifdef __LIBRETRO__
+    /* Does the value change the savestate layout?  */
+    int snapshot_layout;
+#endif
 } resource_ram_t;
 
 
@@ -197,6 +206,71 @@ static void resources_issue_callback(resource_ram_t *res, int global_callback)
     }
 }
 
+#ifdef __LIBRETRO__
+/* Resources that add, drop or resize snapshot modules: memory sizes,
+   expansions, cartridges, drives, SIDs and joyport/userport devices. Names
+   ending in "Model" are included as well, a model switch sets several. */
+static const char * const snapshot_layout_prefixes[] = {
+    "Drive", "IECDevice", "IEEE488", "FileSystemDevice", "VirtualDevices",
+    "RAMBlock", "RamSize", "SIMMSize", "PLUS60K", "PLUS256K", "C64_256K",
+    "MemoryHack", "VDC64KB",
+    "REU", "GEORAM", "RAMCART", "CartridgeType", "CartridgeFile",
+    "SFXSound", "DIGIMAX", "IDE64", "MMC64", "MMCR",
+    "Sid", "JoyPort", "Mouse", "Userport",
+    NULL
+};
+
+static int resources_affects_snapshot_layout(const char *name)
+{
+    size_t len = strlen(name);
+    int i;
+
+    if (len >= 5 && strcmp(name + len - 5, "Model") == 0) {
+        return 1;
+    }
+    for (i = 0; snapshot_layout_prefixes[i] != NULL; i++) {
+        if (strncmp(name, snapshot_layout_prefixes[i], strlen(snapshot_layout_prefixes[i])) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+#endif
+
+/* Value of a resource that shapes the savestate layout, taken before a set
+   and handed to resources_invalidate_snapshot_size(); NULL for all others */
+static char *resources_snapshot_layout_value(const resource_ram_t *r)
+{
+#ifdef __LIBRETRO__
+    if (r->snapshot_layout) {
+        if (r->type == RES_INTEGER) {
+            return lib_msprintf("%d", *(int *)r->value_ptr);
+        }
+        return lib_strdup(*(char **)r->value_ptr != NULL ? *(char **)r->value_ptr : "");
+    }
+#endif
+    return NULL;
+}
+
+/* Drop the cached savestate size if a set changed the layout */
+static void resources_invalidate_snapshot_size(const resource_ram_t *r,
+                                               char *old_value, int status)
+{
+#ifdef __LIBRETRO__
+    if (old_value != NULL) {
+        if (status == 0) {
+            char *new_value = resources_snapshot_layout_value(r);
+
+            if (strcmp(old_value, new_value) != 0) {
+                snapshot_size_invalidate();
+            }
+            lib_free(new_value);
+        }
+        lib_free(old_value);
+    }
+#endif
+}
+
 
 #if 0
 /* for debugging (hash collisions, hash chains, ...) */
@@ -286,6 +360,9 @@ int resources_register_int(const resource_int_t *r)
         dp->set_func_int = sp->set_func;
         dp->param = sp->param;
         dp->callback = NULL;
+#ifdef __LIBRETRO__
+        dp->snapshot_layout = resources_affects_snapshot_layout(sp->name);
+#endif
 
         hashkey = resources_calc_hash_key(sp->name);
         dp->hash_next = hashTable[hashkey];
@@ -340,6 +417,9 @@ int resources_register_string(const resource_string_t *r)
         dp->set_func_string = sp->set_func;
         dp->param = sp->param;
         dp->callback = NULL;
+#ifdef __LIBRETRO__
+        dp->snapshot_layout = resources_affects_snapshot_layout(sp->name);
+#endif
 
         hashkey = resources_calc_hash_key(sp->name);
         dp->hash_next = hashTable[hashkey];
@@ -499,6 +579,7 @@ int resources_init(const char *machine)
 static int resources_set_value_internal(resource_ram_t *r,
                                         resource_value_t value)
 {
+    char *layout_value = resources_snapshot_layout_value(r);
     int status = 0;
 
     switch (r->type) {
@@ -513,6 +594,7 @@ static int resources_set_value_internal(resource_ram_t *r,
     if (status != 0) {
         resources_issue_callback(r, 1);
     }
+    resources_invalidate_snapshot_size(r, layout_value, status);
 
     return status;
 }
@@ -543,6 +625,7 @@ int resources_set_value(const char *name, resource_value_t value)
 
 static int resources_set_internal_int(resource_ram_t *r, int value)
 {
+    char *layout_value = resources_snapshot_layout_value(r);
     int status = 0;
 
     switch (r->type) {
@@ -550,12 +633,14 @@ static int resources_set_internal_int(resource_ram_t *r, int value)
             status = (*r->set_func_int)(value, r->param);
             break;
         default:
+            lib_free(layout_value);
             return -1;
     }
 
     if (status != 0) {
         resources_issue_callback(r, 1);
     }
+    resources_invalidate_snapshot_size(r, layout_value, status);
 
     return status;
 }
@@ -563,6 +648,7 @@ static int resources_set_internal_int(resource_ram_t *r, int value)
 static int resources_set_internal_string(resource_ram_t *r,
                                          const char *value)
 {
+    char *layout_value = resources_snapshot_layout_value(r);
     int status = 0;
 
     switch (r->type) {
@@ -570,12 +656,14 @@ static int resources_set_internal_string(resource_ram_t *r,
             status = (*r->set_func_string)(value, r->param);
             break;
         default:
+            lib_free(layout_value);
             return -1;
     }
 
     if (status != 0) {
         resources_issue_callback(r, 1);
     }
+    resources_invalidate_snapshot_size(r, layout_value, status);
 
     return status;
 }
@@ -677,6 +765,7 @@ int resources_set_string_sprintf(const char *name, const char *value, ...)
 int resources_set_value_string(const char *name, const char *value)
 {
     resource_ram_t *r = lookup(name);
+    char *layout_value;
     int status;
 
     if (r == NULL) {
@@ -686,6 +775,8 @@ int resources_set_value_string(const char *name, const char *value)
         return -1;
     }
 
+    layout_value = resources_snapshot_layout_value(r);
+
     switch (r->type) {
         case RES_INTEGER:
             {
@@ -713,6 +804,7 @@ int resources_set_value_string(const char *name, const char *value)
     if (status != 0) {
         resources_issue_callback(r, 1);
     }
+    resources_invalidate_snapshot_size(r, layout_value, status);
 
     return status;
 }
@@ -218,6 +218,7 @@ int scpu64_snapshot_read_module(snapshot_t *s)
     uint8_t major_version, minor_version;
     snapshot_module_t *m;
     unsigned int simm_mask;
+    int simm_size;
     int trapfl;
 
     /* Main memory module.  */
@@ -261,24 +262,29 @@ int scpu64_snapshot_read_module(snapshot_t *s)
 
     switch (simm_mask) {
     case 0x0:
-        resources_set_int("SIMMSize", 0);
+        simm_size = 0;
         break;
     case 0xfffff:
-        resources_set_int("SIMMSize", 1);
+        simm_size = 1;
         break;
     case 0x3fffff:
-        resources_set_int("SIMMSize", 4);
+        simm_size = 4;
         break;
     case 0x7fffff:
-        resources_set_int("SIMMSize", 8);
+        simm_size = 8;
         break;
     case 0xffffff:
-        resources_set_int("SIMMSize", 16);
+        simm_size = 16;
         break;
     default:
         goto fail;
     }
 
+    /* resizing clears the whole SIMM, which is loaded right after anyway */
+    if (simm_mask != mem_simm_ram_mask) {
+        resources_set_int("SIMMSize", simm_size);
+    }
+
     if (SMR_BA(m, mem_simm_ram, mem_simm_ram_mask + 1) < 0) {
         goto fail;
     }
@@ -65,6 +65,13 @@ extern sid_engine_t residfp_hooks;
 #endif
 #endif
 
+#if defined(__LIBRETRO__) && (defined(__X64__) || defined(__X64SC__) || defined(__XSCPU64__) || defined(__X128__))
+#define SID_QUEUE
+#ifdef HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
+#endif
+
 /* SID engine hooks. */
 static sid_engine_t sid_engine;
 
@@ -455,13 +462,409 @@ bool sid_sound_machine_set_engine_hooks(void)
     return false;
 }
 
+#ifdef SID_QUEUE
+/* Queued rendering: writes to the cycle based engines are queued per chip
+   with their cycle, and each chip is rendered over the whole span when the
+   samples are needed, replaying its writes at the exact cycles. A register
+   read only brings the chip being read up to date, into its own buffer.
+   The chips do not depend on each other, so they can render on worker
+   threads, and the mixing sees the same samples as with rendering on every
+   write. Fast sampling depends on where the clocking is split, so it keeps
+   rendering on every write. */
+extern unsigned int opt_sid_render;
+
+#define SID_QUEUE_MAX 16384
+#define SID_RENDER_THREAD_CYCLES 2048
+#define SID_RENDER_READ_MAX 65536
+
+typedef struct sid_write_s {
+    CLOCK clk;
+    uint8_t addr;
+    uint8_t byte;
+} sid_write_t;
+
+typedef struct sid_chip_render_s {
+    sound_t *psid;
+    CLOCK clk;          /* cycle the engine has been clocked to */
+    sid_write_t *queue;
+    int queued;
+    int consumed;
+    int16_t *buf;       /* samples rendered since the span start */
+    int buf_len;
+    int nr;
+    int partial;        /* brought up to date by a read */
+} sid_chip_render_t;
+
+static sid_chip_render_t sid_render[SOUND_SIDS_MAX];
+static int sid_render_pending = 0;
+static int sid_render_partial = 0;
+static int sid_render_active = 0;
+static CLOCK sid_render_end;
+static int sid_render_fast_sampling = 0;
+
+#define sid_render_mode (sid_render_fast_sampling ? SID_RENDER_CYCLE : opt_sid_render)
+
+static int sid_render_chipno(sound_t *psid)
+{
+    int chipno;
+
+    for (chipno = 0; chipno < SOUND_SIDS_MAX; chipno++) {
+        if (sound_get_psid(chipno) == psid) {
+            return chipno;
+        }
+    }
+    return -1;
+}
+
+static void sid_render_queue_clear(int chipno)
+{
+    sid_render_pending -= sid_render[chipno].queued;
+    sid_render[chipno].queued = 0;
+}
+
+/* Drop what is pending and start the next span at 'clk' */
+static void sid_render_restart(int chipno, sound_t *psid, CLOCK clk)
+{
+    sid_chip_render_t *r = &sid_render[chipno];
+
+    sid_render_queue_clear(chipno);
+    r->psid = psid;
+    r->clk = clk;
+    r->nr = 0;
+    r->partial = 0;
+}
+
+static void sid_store_queued(uint16_t addr, uint8_t byte, int chipno)
+{
+    sid_chip_render_t *r = &sid_render[chipno];
+    sid_write_t *w;
+
+    if (sid_render_mode == SID_RENDER_CYCLE || sound_get_psid(chipno) == NULL) {
+        sound_store(addr, byte, chipno);
+        return;
+    }
+
+    if (r->queued == SID_QUEUE_MAX) {
+        /* Renders the queue, which is stale if sound is not running */
+        sound_store(addr, byte, chipno);
+        sid_render_queue_clear(chipno);
+        return;
+    }
+
+    if (r->queue == NULL) {
+        r->queue = lib_malloc(SID_QUEUE_MAX * sizeof(sid_write_t));
+    }
+    w = &r->queue[r->queued++];
+    w->clk = maincpu_clk;
+    w->addr = (uint8_t)addr;
+    w->byte = byte;
+    sid_render_pending++;
+}
+
+/* Clock the engine up to 'clk', appending the samples to the chip buffer */
+static void sid_render_samples(sid_chip_render_t *r, CLOCK clk)
+{
+    int delta_t = (int)(clk - r->clk);
+
+    while (delta_t > 0) {
+        int before = delta_t;
+
+        if (r->nr == r->buf_len) {
+            r->buf_len = r->buf_len ? r->buf_len * 2 : 1024;
+            r->buf = lib_realloc(r->buf, r->buf_len * sizeof(int16_t));
+        }
+        r->nr += sid_engine.calculate_samples(r->psid, r->buf + r->nr, r->buf_len - r->nr, 1, &delta_t);
+        if (delta_t == before && r->nr < r->buf_len) {
+            break;
+        }
+    }
+    r->clk = clk;
+}
+
+/* Bring one chip up to 'end', replaying its queued writes on the way. With
+   'to_end' unset the engine stops at the last write. */
+static void sid_render_chip(sid_chip_render_t *r, CLOCK end, int to_end)
+{
+    int i;
+
+    for (i = 0; i < r->queued && r->queue[i].clk <= end; i++) {
+        sid_write_t *w = &r->queue[i];
+
+        if (w->clk > r->clk) {
+            sid_render_samples(r, w->clk);
+        }
+        sid_engine.store(r->psid, w->addr, w->byte);
+    }
+    if (to_end && end > r->clk) {
+        sid_render_samples(r, end);
+    }
+
+    if (i) {
+        memmove(r->queue, r->queue + i, (r->queued - i) * sizeof(sid_write_t));
+        r->queued -= i;
+    }
+    r->consumed = i;
+}
+
+static int sid_read_queued(uint16_t addr, int chipno)
+{
+    sid_chip_render_t *r = &sid_render[chipno];
+
+    if (sid_render_mode == SID_RENDER_CYCLE
+        || r->psid == NULL || r->psid != sound_get_psid(chipno)
+        || r->nr >= SID_RENDER_READ_MAX) {
+        return sound_read(addr, chipno);
+    }
+
+    /* Catch up this chip only, the samples wait for the end of the span */
+    sid_render_chip(r, maincpu_clk, 1);
+    sid_render_pending -= r->consumed;
+    sid_render_partial = r->partial = 1;
+
+    return sid_engine.read(r->psid, addr);
+}
+
+/* Engine hook while mixing, hands out the rendered samples */
+static int sid_render_copy(sound_t *psid, short *pbuf, int nr, int interleave, int *delta_t)
+{
+    sid_chip_render_t *r = sid_render;
+    int i;
+
+    while (r->psid != psid && r < sid_render + SOUND_SIDS_MAX - 1) {
+        r++;
+    }
+    if (nr > r->nr) {
+        nr = r->nr;
+    }
+    for (i = 0; i < nr; i++) {
+        pbuf[i * interleave] = r->buf[i];
+    }
+    /* Samples that do not fit are reported as an overflow */
+    *delta_t = (r->nr > nr);
+    return nr;
+}
+
+#ifdef HAVE_THREADS
+static sthread_t *sid_render_thread[SOUND_SIDS_MAX - 1];
+static int sid_render_threads = 0;
+static slock_t *sid_render_lock = NULL;
+static scond_t *sid_render_start_cond = NULL;
+static scond_t *sid_render_done_cond = NULL;
+static unsigned int sid_render_generation = 0;
+static int sid_render_chips = 0;
+static int sid_render_next = 0;
+static int sid_render_done = 0;
+static int sid_render_quit = 0;
+
+/* Render chips of the current job until none are left, called locked */
+static void sid_render_take(void)
+{
+    while (sid_render_next < sid_render_chips) {
+        sid_chip_render_t *r = &sid_render[sid_render_next++];
+
+        slock_unlock(sid_render_lock);
+        sid_render_chip(r, sid_render_end, 1);
+        slock_lock(sid_render_lock);
+        if (++sid_render_done == sid_render_chips) {
+            scond_signal(sid_render_done_cond);
+        }
+    }
+}
+
+static void sid_render_thread_func(void *data)
+{
+    unsigned int generation;
+
+    slock_lock(sid_render_lock);
+    generation = sid_render_generation;
+    while (!sid_render_quit) {
+        if (generation == sid_render_generation) {
+            scond_wait(sid_render_start_cond, sid_render_lock);
+            continue;
+        }
+        generation = sid_render_generation;
+        sid_render_take();
+    }
+    slock_unlock(sid_render_lock);
+}
+
+/* Render 'chips' chips on the calling thread and the workers */
+static void sid_render_threaded(int chips)
+{
+    if (sid_render_lock == NULL) {
+        sid_render_lock = slock_new();
+        sid_render_start_cond = scond_new();
+        sid_render_done_cond = scond_new();
+    }
+    while (sid_render_threads < chips - 1) {
+        sthread_t *thread = sthread_create(sid_render_thread_func, NULL);
+        if (thread == NULL) {
+            break;
+        }
+        sid_render_thread[sid_render_threads++] = thread;
+    }
+
+    slock_lock(sid_render_lock);
+    sid_render_chips = chips;
+    sid_render_next = 0;
+    sid_render_done = 0;
+    sid_render_generation++;
+    scond_broadcast(sid_render_start_cond);
+    sid_render_take();
+    while (sid_render_done < sid_render_chips) {
+        scond_wait(sid_render_done_cond, sid_render_lock);
+    }
+    slock_unlock(sid_render_lock);
+}
+#endif
+
+static int sid_calculate_queued(sound_t **psid, int16_t *pbuf, int nr, int soc, int scc, int *delta_t)
+{
+    int (*calculate_samples)(sound_t *psid, short *pbuf, int nr, int interleave, int *delta_t) = sid_engine.calculate_samples;
+    CLOCK start = maincpu_clk - (CLOCK)*delta_t;
+    int chipno;
+    int retval;
+
+    sid_render_end = maincpu_clk;
+    for (chipno = 0; chipno < scc; chipno++) {
+        sid_chip_render_t *r = &sid_render[chipno];
+
+        r->psid = psid[chipno];
+        if (!r->partial) {
+            r->clk = start;
+        }
+        if (r->buf_len < nr) {
+            r->buf = lib_realloc(r->buf, nr * sizeof(int16_t));
+            r->buf_len = nr;
+        }
+    }
+
+#ifdef HAVE_THREADS
+    /* Short spans from register reads are not worth the hand over */
+    if (scc > 1 && sid_render_mode == SID_RENDER_THREADED && *delta_t >= SID_RENDER_THREAD_CYCLES) {
+        sid_render_threaded(scc);
+    } else
+#endif
+    {
+        for (chipno = 0; chipno < scc; chipno++) {
+            sid_render_chip(&sid_render[chipno], sid_render_end, 1);
+        }
+    }
+    for (chipno = 0; chipno < scc; chipno++) {
+        sid_render_pending -= sid_render[chipno].consumed;
+    }
+
+    /* Mix as usual, with the engine handing out what was rendered */
+    sid_render_active = 1;
+    sid_engine.calculate_samples = sid_render_copy;
+    retval = sid_sound_machine_calculate_samples(psid, pbuf, nr, soc, scc, delta_t);
+    sid_engine.calculate_samples = calculate_samples;
+    sid_render_active = 0;
+
+    for (chipno = 0; chipno < scc; chipno++) {
+        sid_render[chipno].nr = 0;
+        sid_render[chipno].partial = 0;
+    }
+    sid_render_partial = 0;
+
+    return retval;
+}
+#endif
+
+#ifdef SID_QUEUE
+/* Stop the workers, which are shared by all chips */
+static void sid_render_threads_stop(void)
+{
+#ifdef HAVE_THREADS
+    if (sid_render_lock) {
+        int i;
+
+        slock_lock(sid_render_lock);
+        sid_render_quit = 1;
+        scond_broadcast(sid_render_start_cond);
+        slock_unlock(sid_render_lock);
+        for (i = 0; i < sid_render_threads; i++) {
+            sthread_join(sid_render_thread[i]);
+        }
+        sid_render_threads = 0;
+        sid_render_quit = 0;
+
+        scond_free(sid_render_start_cond);
+        scond_free(sid_render_done_cond);
+        slock_free(sid_render_lock);
+        sid_render_start_cond = NULL;
+        sid_render_done_cond = NULL;
+        sid_render_lock = NULL;
+    }
+#endif
+}
+
+static void sid_render_free(int chipno)
+{
+    sid_chip_render_t *r = &sid_render[chipno];
+
+    sid_render_queue_clear(chipno);
+    lib_free(r->queue);
+    lib_free(r->buf);
+    memset(r, 0, sizeof(sid_chip_render_t));
+}
+
+/* Drop the pending writes of a closing chip, they are already in siddata
+   for the next open, and stop the workers with the last chip */
+static void sid_render_close(sound_t *psid)
+{
+    int chipno;
+    int open = 0;
+
+    for (chipno = 0; chipno < SOUND_SIDS_MAX; chipno++) {
+        if (psid != NULL && sid_render[chipno].psid == psid) {
+            sid_render_free(chipno);
+        } else if (sid_render[chipno].psid != NULL) {
+            open++;
+        }
+    }
+
+    if (!open) {
+        sid_render_threads_stop();
+        sid_render_partial = 0;
+    }
+}
+#endif
+
+#ifdef __LIBRETRO__
+void sid_sound_machine_render_shutdown(void)
+{
+#ifdef SID_QUEUE
+    int chipno;
+
+    sid_render_threads_stop();
+    for (chipno = 0; chipno < SOUND_SIDS_MAX; chipno++) {
+        sid_render_free(chipno);
+    }
+    sid_render_pending = 0;
+    sid_render_partial = 0;
+#endif
+}
+#endif
+
 sound_t *sid_sound_machine_open(int chipno)
 {
     if (!sid_sound_machine_set_engine_hooks()) {
         return NULL;
     }
 
+#ifdef SID_QUEUE
+    {
+        int sampling = SID_RESID_SAMPLING_RESAMPLING;
+
+        resources_get_int("SidResidSampling", &sampling);
+        sid_render_fast_sampling = (sampling == SID_RESID_SAMPLING_FAST);
+    }
+    sid_render_restart(chipno, sid_engine.open(siddata[chipno]), maincpu_clk);
+    return sid_render[chipno].psid;
+#else
     return sid_engine.open(siddata[chipno]);
+#endif
 }
 
 /* manage temporary buffers. if the requested size is smaller or equal to the
@@ -518,6 +921,9 @@ int sid_sound_machine_init(sound_t *psid, int speed, int cycles_per_sec)
 
 void sid_sound_machine_close(sound_t *psid)
 {
+#ifdef SID_QUEUE
+    sid_render_close(psid);
+#endif
     sid_engine.close(psid);
     /* free the temp. buffers */
     if (buf1) {
@@ -569,6 +975,17 @@ void sid_sound_machine_store(sound_t *psid, uint16_t addr, uint8_t byte)
 
 void sid_sound_machine_reset(sound_t *psid, CLOCK cpu_clk)
 {
+#ifdef SID_QUEUE
+    int chipno = sid_render_chipno(psid);
+
+    /* The writes up to the reset still reach the engine */
+    if (chipno >= 0) {
+        sid_render[chipno].psid = psid;
+        sid_render_chip(&sid_render[chipno], cpu_clk, 0);
+        sid_render_pending -= sid_render[chipno].consumed;
+        sid_render_restart(chipno, psid, cpu_clk);
+    }
+#endif
     sid_engine.reset(psid, cpu_clk);
 }
 
@@ -585,6 +1002,18 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
     int tmp_nr = 0;
     int tmp_delta_t = *delta_t;
 
+#ifdef SID_QUEUE
+    if (!sid_render_active && (sid_render_pending || sid_render_partial || sid_render_mode != SID_RENDER_CYCLE)
+        && sid_sound_machine_cycle_based()) {
+        return sid_calculate_queued(psid, pbuf, nr, soc, scc, delta_t);
+    }
+    if (!sid_render_active) {
+        for (i = 0; i < scc; i++) {
+            sid_render[i].clk = maincpu_clk;
+        }
+    }
+#endif
+
     if (soc == 1 && scc == 1) {
         return sid_engine.calculate_samples(psid[0], pbuf, nr, 1, delta_t);
     }
@@ -866,6 +1295,17 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
 
 void sid_sound_machine_prevent_clk_overflow(sound_t *psid, CLOCK sub)
 {
+#ifdef SID_QUEUE
+    int chipno = sid_render_chipno(psid);
+    int i;
+
+    if (chipno >= 0) {
+        sid_render[chipno].clk -= sub;
+        for (i = 0; i < sid_render[chipno].queued; i++) {
+            sid_render[chipno].queue[i].clk -= sub;
+        }
+    }
+#endif
     sid_engine.prevent_clk_overflow(psid, sub);
 }
 
@@ -929,21 +1369,26 @@ static void set_sound_func(void)
         }
 #ifdef HAVE_RESID
         if (sid_engine_type == SID_ENGINE_RESID) {
+#ifdef SID_QUEUE
+            sid_read_func = sid_read_queued;
+            sid_store_func = sid_store_queued;
+#else
             sid_read_func = sound_read;
             sid_store_func = sound_store;
+#endif
             sid_dump_func = sound_dump;
         }
 #if defined(__LIBRETRO__) && (defined(__X64__) || defined(__X64SC__) || defined(__XSCPU64__) || defined(__X128__))
 #ifdef HAVE_RESID33
         if (sid_engine_type == SID_ENGINE_RESID33) {
-            sid_read_func = sound_read;
-            sid_store_func = sound_store;
+            sid_read_func = sid_read_queued;
+            sid_store_func = sid_store_queued;
             sid_dump_func = sound_dump;
         }
 #endif
         if (sid_engine_type == SID_ENGINE_RESIDFP) {
-            sid_read_func = sound_read;
-            sid_store_func = sound_store;
+            sid_read_func = sid_read_queued;
+            sid_store_func = sid_store_queued;
             sid_dump_func = sound_dump;
         }
 #endif
@@ -1064,6 +1509,9 @@ void sid_state_write(unsigned int channel, sid_snapshot_state_t *sid_state)
             fprintf(stderr, "%s:%d:%s(): sound_get_psid() returned NULL\n",
                     __FILE__, __LINE__, __func__);
         } else {
+#ifdef SID_QUEUE
+            sid_render_restart((int)channel, psid, maincpu_clk);
+#endif
             sid_engine.state_write(psid, sid_state);
         }
     }
@@ -237,4 +237,13 @@ int sid_machine_get_max_sids(void);
 int sid_machine_engine_get_max_sids(int engine);
 int sid_machine_can_have_multiple_sids(void);
 
+#ifdef __LIBRETRO__
+/* SID rendering modes */
+#define SID_RENDER_CYCLE          0
+#define SID_RENDER_FRAME          1
+#define SID_RENDER_THREADED       2
+
+extern void sid_sound_machine_render_shutdown(void);
+#endif
+
 #endif
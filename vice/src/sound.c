@@ -1334,8 +1334,14 @@ bool sound_flush()
         }
     }
 
+#ifdef __LIBRETRO__
+    /* The frontend takes any number of samples, so flush all of them
+       and leave no incomplete fragment to be moved back.  */
+    nr = snddata.bufptr;
+#else
     /* Calculate the number of samples to flush - whole fragments. */
     nr = snddata.bufptr - snddata.bufptr % snddata.fragsize;
+#endif
     if (!nr) {
         goto done;
     }
@@ -1359,7 +1365,9 @@ bool sound_flush()
             space = nr;
         }
 
+#ifndef __LIBRETRO__
         space -= space % snddata.fragsize;
+#endif
         
         if (space) {
             if (nr > space) {
@@ -1659,6 +1667,48 @@ void sound_snapshot_finish(void)
     snddata.lastclk = maincpu_clk;
 }
 
+#ifdef __LIBRETRO__
+/* Run-ahead rolls back the frames emulated ahead, so the samples pending
+   at the checkpoint are put back and the ones generated since dropped. */
+static int16_t *runahead_buffer = NULL;
+static int runahead_bufptr = -1;
+static soundclk_t runahead_fclk;
+static CLOCK runahead_wclk;
+
+void sound_runahead_save(void)
+{
+    size_t size;
+
+    runahead_bufptr = -1;
+    if (snddata.buffer == NULL) {
+        return;
+    }
+
+    size = (size_t)snddata.bufptr * snddata.sound_output_channels * sizeof(int16_t);
+    runahead_buffer = lib_realloc(runahead_buffer, size ? size : 1);
+    memcpy(runahead_buffer, snddata.buffer, size);
+    runahead_bufptr = snddata.bufptr;
+    runahead_fclk = snddata.fclk;
+    runahead_wclk = snddata.wclk;
+}
+
+void sound_runahead_restore(void)
+{
+    /* Device was reopened in between */
+    if (runahead_bufptr < 0 || snddata.buffer == NULL || runahead_bufptr > snddata.bufsize) {
+        return;
+    }
+
+    memcpy(snddata.buffer, runahead_buffer,
+           (size_t)runahead_bufptr * snddata.sound_output_channels * sizeof(int16_t));
+    snddata.bufptr = runahead_bufptr;
+    snddata.fclk = runahead_fclk;
+    snddata.wclk = runahead_wclk;
+    snddata.lastclk = maincpu_clk;
+    runahead_bufptr = -1;
+}
+#endif
+
 void sound_dac_init(sound_dac_t *dac, int speed)
 {
     /* 20 dB/Decade high pass filter, cutoff at 5 Hz. For DC offset filtering. */
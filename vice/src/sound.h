@@ -170,6 +170,10 @@ extern void sound_set_warp_mode(int value);
 extern void sound_set_machine_parameter(long clock_rate, long ticks_per_frame);
 extern void sound_snapshot_prepare(void);
 extern void sound_snapshot_finish(void);
+#ifdef __LIBRETRO__
+extern void sound_runahead_save(void);
+extern void sound_runahead_restore(void);
+#endif
 
 extern int sound_resources_init(void);
 extern void sound_resources_shutdown(void);
@@ -41,6 +41,7 @@
 #include "maincpu.h"
 #include "mem.h"
 #include "network.h"
+#include "snapshot.h"
 #include "t64.h"
 #include "tap.h"
 #include "tape-internal.h"
@@ -454,6 +455,10 @@ int tape_image_detach_internal(unsigned int unit)
         return 0;
     }
 
+#ifdef __LIBRETRO__
+    snapshot_size_invalidate();
+#endif
+
     switch (tape_image_dev1->type) {
         case TAPE_TYPE_T64:
             log_message(tape_log,
@@ -521,6 +526,10 @@ static int tape_image_attach_internal(unsigned int unit, const char *name)
         return -1;
     }
 
+#ifdef __LIBRETRO__
+    snapshot_size_invalidate();
+#endif
+
     tape_image.name = lib_strdup(name);
     tape_image.read_only = 0;
 
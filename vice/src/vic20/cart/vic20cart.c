@@ -350,6 +350,10 @@ int cartridge_attach_image(int type, const char *filename)
         return 0;
     }
 
+#ifdef __LIBRETRO__
+    snapshot_size_invalidate();
+#endif
+
     log_message(LOG_DEFAULT, "Attached cartridge type %d, file=`%s'.", type, filename);
 
     type_orig = type;
@@ -425,6 +429,10 @@ int cartridge_attach_image(int type, const char *filename)
 
 void cartridge_detach_image(int type)
 {
+#ifdef __LIBRETRO__
+    snapshot_size_invalidate();
+#endif
+
     cartridge_detach(vic20cart_type);
     vic20cart_type = CARTRIDGE_NONE;
     cartridge_is_from_snapshot = 0;
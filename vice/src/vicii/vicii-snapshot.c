@@ -34,6 +34,7 @@
 #include "interrupt.h"
 #include "log.h"
 #include "mem.h"
+#include "raster-changes.h"
 #include "raster-sprite-status.h"
 #include "raster-sprite.h"
 #include "snapshot.h"
@@ -388,6 +389,15 @@ int vicii_snapshot_read_module(snapshot_t *s)
 
     vicii_update_memory_ptrs(VICII_RASTER_CYCLE(maincpu_clk));
 
+    /* Changes still pending belong to the replaced state, and loading again
+       before a line is drawn would overflow them.  */
+    raster_changes_remove_all(vicii.raster.changes->background);
+    raster_changes_remove_all(vicii.raster.changes->foreground);
+    raster_changes_remove_all(vicii.raster.changes->border);
+    raster_changes_remove_all(vicii.raster.changes->sprites);
+    raster_changes_remove_all(vicii.raster.changes->next_line);
+    vicii.raster.changes->have_on_this_line = 0;
+
     /* Update sprite parameters.  We had better do this manually, or the
        VIC-II emulation could be quite upset.  */
     {
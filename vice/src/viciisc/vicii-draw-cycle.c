@@ -117,6 +117,13 @@ static uint8_t last_color_value;
 
 static unsigned int cycle_flags_pipe;
 
+/* no mode register write since the start of the previous line */
+static int mode_line_clean = 0;
+
+/* resolved graphics colors for the current latch, keyed by mode and vbuf/cbuf */
+static uint8_t run_colors[4];
+static int run_colors_key = -1;
+
 void vicii_monitor_colreg_store(int reg, int value)
 {
     cregs[reg] = value;
@@ -141,6 +148,35 @@ static const uint8_t colors[] = {
     COL_NONE, COL_NONE, COL_NONE, COL_NONE          /* ECM=1 BMM=1 MCM=1 */
 };
 
+/* lookup colors for a graphics pixel */
+static DRAW_INLINE uint8_t get_graphics_color(uint8_t cc)
+{
+    switch (cc) {
+        case COL_NONE:
+            cc = 0;
+            break;
+        case COL_VBUF_L:
+            cc = vbuf_reg & 0x0f;
+            break;
+        case COL_VBUF_H:
+            cc = vbuf_reg >> 4;
+            break;
+        case COL_CBUF:
+            cc = cbuf_reg;
+            break;
+        case COL_CBUF_MC:
+            cc = cbuf_reg & 0x07;
+            break;
+        case COL_D02X_EXT:
+            cc = COL_D021 + (vbuf_reg >> 6);
+            break;
+        default:
+            break;
+    }
+
+    return cc;
+}
+
 static DRAW_INLINE void draw_graphics(int i)
 {
     uint8_t px;
@@ -194,36 +230,96 @@ static DRAW_INLINE void draw_graphics(int i)
     /* Determine pixel color and priority */
     vmode = vmode11_pipe | vmode16_pipe;
     pixel_pri = (px & 0x2);
-    cc = colors[vmode | px];
-
-    /* lookup colors and render pixel */
-    switch (cc) {
-        case COL_NONE:
-            cc = 0;
-            break;
-        case COL_VBUF_L:
-            cc = vbuf_reg & 0x0f;
-            break;
-        case COL_VBUF_H:
-            cc = vbuf_reg >> 4;
-            break;
-        case COL_CBUF:
-            cc = cbuf_reg;
-            break;
-        case COL_CBUF_MC:
-            cc = cbuf_reg & 0x07;
-            break;
-        case COL_D02X_EXT:
-            cc = COL_D021 + (vbuf_reg >> 6);
-            break;
-        default:
-            break;
-    }
+    cc = get_graphics_color(colors[vmode | px]);
 
     render_buffer[i] = cc;
     pri_buffer[i] = pixel_pri;
 }
 
+/*
+ * Draw pixels i..end-1 of the current latch with settled mode pipes.
+ * The colors only depend on the mode and the latched vbuf/cbuf, so they
+ * are looked up once per latch instead of once per pixel.
+ */
+static DRAW_INLINE void draw_graphics_run(int i, int end)
+{
+    uint8_t vmode = vmode11_pipe | vmode16_pipe;
+    int mc = (vmode11_pipe & 0x08) || (cbuf_reg & 0x08);
+    int key = (vmode << 16) | (vbuf_reg << 8) | cbuf_reg;
+
+    if (i == end) {
+        return;
+    }
+
+    if (key != run_colors_key) {
+        int px;
+
+        for (px = 0; px < 4; px++) {
+            run_colors[px] = get_graphics_color(colors[vmode | px]);
+        }
+        run_colors_key = key;
+    }
+
+    if (vmode16_pipe2 && mc) {
+        /* mc pixels */
+        for (; i < end; i++) {
+            if (gbuf_mc_flop) {
+                gbuf_pixel_reg = gbuf_reg >> 6;
+            }
+            gbuf_reg <<= 1;
+            gbuf_mc_flop ^= 1;
+            render_buffer[i] = run_colors[gbuf_pixel_reg];
+            pri_buffer[i] = gbuf_pixel_reg & 0x2;
+        }
+    } else {
+        /* hires pixels, see draw_graphics() for the MCM=0 kludge */
+        uint8_t fg = (!vmode16_pipe2 && mc) ? 2 : 3;
+
+        for (; i < end; i++) {
+            gbuf_pixel_reg = (gbuf_reg & 0x80) ? fg : 0;
+            gbuf_reg <<= 1;
+            gbuf_mc_flop ^= 1;
+            render_buffer[i] = run_colors[gbuf_pixel_reg];
+            pri_buffer[i] = gbuf_pixel_reg & 0x2;
+        }
+    }
+}
+
+/* shift and put the next data into the pipe. */
+static DRAW_INLINE void update_graphics_pipe(int vis_en)
+{
+    vbuf_pipe1_reg = vbuf_pipe0_reg;
+    cbuf_pipe1_reg = cbuf_pipe0_reg;
+    gbuf_pipe1_reg = gbuf_pipe0_reg;
+
+    /* this makes sure gbuf is 0 outside the visible area
+       It should probably be done somewhere around the fetch instead */
+    if (vis_en && vicii.vborder == 0) {
+        gbuf_pipe0_reg = vicii.gbuf;
+        xscroll_pipe = vicii.regs[0x16] & 0x07;
+    } else {
+        gbuf_pipe0_reg = 0;
+    }
+
+    /* Only update vbuf and cbuf registers in the display state. */
+    if (vis_en && vicii.vborder == 0) {
+        if (!vicii.idle_state) {
+            vbuf_pipe0_reg = vicii.vbuf[dmli];
+            cbuf_pipe0_reg = vicii.cbuf[dmli];
+        } else {
+            vbuf_pipe0_reg = 0;
+            cbuf_pipe0_reg = 0;
+        }
+    }
+
+    /* update display index in the visible region */
+    if (vis_en) {
+        dmli++;
+    } else {
+        dmli = 0;
+    }
+}
+
 static DRAW_INLINE void draw_graphics8(unsigned int cycle_flags)
 {
     int vis_en;
@@ -265,37 +361,60 @@ static DRAW_INLINE void draw_graphics8(unsigned int cycle_flags)
         vmode11_pipe = ( vicii.regs[0x11] & 0x60 ) >> 2;
     }
 
-    /* shift and put the next data into the pipe. */
-    vbuf_pipe1_reg = vbuf_pipe0_reg;
-    cbuf_pipe1_reg = cbuf_pipe0_reg;
-    gbuf_pipe1_reg = gbuf_pipe0_reg;
+    update_graphics_pipe(vis_en);
+}
 
-    /* this makes sure gbuf is 0 outside the visible area
-       It should probably be done somewhere around the fetch instead */
-    if (vis_en && vicii.vborder == 0) {
-        gbuf_pipe0_reg = vicii.gbuf;
-        xscroll_pipe = vicii.regs[0x16] & 0x07;
-    } else {
-        gbuf_pipe0_reg = 0;
-    }
+/*
+ * Variant of draw_graphics8() for cycles fully covered by the border while
+ * the graphics shifter is empty. The pixels would be overwritten with the
+ * border color anyway, so only the pipeline state is advanced.
+ */
+static DRAW_INLINE void draw_graphics8_border(unsigned int cycle_flags)
+{
+    /* latch values at time xs, gbuf stays empty */
+    vbuf_reg = vbuf_pipe1_reg;
+    cbuf_reg = cbuf_pipe1_reg;
 
-    /* Only update vbuf and cbuf registers in the display state. */
-    if (vis_en && vicii.vborder == 0) {
-        if (!vicii.idle_state) {
-            vbuf_pipe0_reg = vicii.vbuf[dmli];
-            cbuf_pipe0_reg = vicii.cbuf[dmli];
-        } else {
-            vbuf_pipe0_reg = 0;
-            cbuf_pipe0_reg = 0;
-        }
-    }
+    /* both color latency variants end up with the current mode bits */
+    vmode16_pipe = ( vicii.regs[0x16] & 0x10 ) >> 2;
+    vmode11_pipe = ( vicii.regs[0x11] & 0x60 ) >> 2;
 
-    /* update display index in the visible region */
-    if (vis_en) {
-        dmli++;
+    /* mc flop is set at the latch and toggles on every following pixel,
+       a rising MCM edge clears it before pixel 7 */
+    if (xscroll_pipe == 7) {
+        gbuf_mc_flop = 0;
+    } else if (vmode16_pipe && !vmode16_pipe2) {
+        gbuf_mc_flop = 1;
     } else {
-        dmli = 0;
+        gbuf_mc_flop = (xscroll_pipe & 1) ? 0 : 1;
     }
+    vmode16_pipe2 = vmode16_pipe;
+
+    /* no foreground pixels for sprite priority and collisions */
+    memset(pri_buffer, 0, sizeof(pri_buffer));
+
+    update_graphics_pipe(cycle_is_visible(cycle_flags));
+}
+
+/*
+ * Variant of draw_graphics8() for clean lines. The mode registers were not
+ * written since the start of the previous line, so the mode pipes already
+ * hold the register values. The pixels before and after the latch are drawn
+ * in two runs.
+ */
+static DRAW_INLINE void draw_graphics8_clean(unsigned int cycle_flags)
+{
+    draw_graphics_run(0, xscroll_pipe);
+
+    /* latch values at time xs */
+    vbuf_reg = vbuf_pipe1_reg;
+    cbuf_reg = cbuf_pipe1_reg;
+    gbuf_reg = gbuf_pipe1_reg;
+    gbuf_mc_flop = 1;
+
+    draw_graphics_run(xscroll_pipe, 8);
+
+    update_graphics_pipe(cycle_is_visible(cycle_flags));
 }
 
 
@@ -488,6 +607,23 @@ static DRAW_INLINE void draw_sprites8(unsigned int cycle_flags)
     if (cycle_is_sprite_dma1_dma2(cycle_flags)) {
         dma_cycle_2 = 1 << cycle_get_sprite_num(cycle_flags);
     }
+    /* early exit if no sprite is shifting out or can be triggered */
+    if (!(sprite_active_bits | sprite_pending_bits)
+        && !(spr_en && vicii.sprite_display_bits)) {
+        sprite_halt_bits |= dma_cycle_0;
+        update_sprite_data(cycle_flags);
+        if (vicii.color_latency) {
+            update_sprite_mc_bits_6569();
+        } else {
+            update_sprite_mc_bits_8565();
+        }
+        sprite_pri_bits = vicii.regs[0x1b];
+        sprite_expx_bits = vicii.regs[0x1d];
+        sprite_halt_bits &= ~dma_cycle_2;
+        update_sprite_xpos();
+        return;
+    }
+
     candidate_bits = get_trigger_candidates(xpos);
 
     /* process and render sprites */
@@ -636,11 +772,33 @@ static DRAW_INLINE void draw_colors8(void)
         return;
     }
 
-    /* update color register (if written) */
-    if (last_color_reg != 0xff) {
-        cregs[last_color_reg] = last_color_value;
+    /* no color register written, resolve against unchanged cregs */
+    if (last_color_reg == 0xff) {
+        int i;
+
+        if (vicii.color_latency) {
+            /* pixel 0 was already resolved in the previous cycle */
+            vicii.dbuf[offs] = pixel_buffer[0];
+            for (i = 1; i < 8; i++) {
+                vicii.dbuf[offs + i] = cregs[pixel_buffer[i]];
+            }
+            memcpy(pixel_buffer, render_buffer, sizeof(pixel_buffer));
+            pixel_buffer[0] = cregs[pixel_buffer[0]];
+        } else {
+            for (i = 0; i < 8; i++) {
+                vicii.dbuf[offs + i] = cregs[pixel_buffer[i]];
+            }
+            memcpy(pixel_buffer, render_buffer, sizeof(pixel_buffer));
+        }
+        vicii.dbuf_offset += 8;
+
+        update_cregs();
+        return;
     }
 
+    /* update color register (if written) */
+    cregs[last_color_reg] = last_color_value;
+
     /* render pixels */
     if (vicii.color_latency) {
         draw_colors_6569(offs, 0);
@@ -678,9 +836,21 @@ void vicii_draw_cycle(void)
     /* reset rendering on raster cycle 1 */
     if (vicii.raster_cycle == 1) {
         vicii.dbuf_offset = 0;
+
+        /* the line is clean if the previous one had no mode register writes */
+        mode_line_clean = !vicii.mode_line_dirty;
+        vicii.mode_line_dirty = 0;
     }
 
-    draw_graphics8(cycle_flags_pipe);
+    /* the border covers the whole cycle and no graphics are left to shift out */
+    if (border_state && vicii.main_border && !(gbuf_reg | gbuf_pipe1_reg | gbuf_pixel_reg)) {
+        draw_graphics8_border(cycle_flags_pipe);
+    } else if (mode_line_clean && !vicii.mode_line_dirty) {
+        /* falls back to draw_graphics8() for the rest of the line on a write */
+        draw_graphics8_clean(cycle_flags_pipe);
+    } else {
+        draw_graphics8(cycle_flags_pipe);
+    }
 
     draw_sprites8(cycle_flags_pipe);
 
@@ -712,6 +882,10 @@ void vicii_draw_cycle_init(void)
     last_color_reg = 0xff;
 
     cycle_flags_pipe = 0;
+
+    /* the mode pipes are not known to be settled yet */
+    vicii.mode_line_dirty = 1;
+    mode_line_clean = 0;
 }
 
 
@@ -848,5 +1022,9 @@ int vicii_draw_cycle_snapshot_read(snapshot_module_t *m)
         return -1;
     }
 
+    /* the pipes may still hold a mode from before the last write */
+    vicii.mode_line_dirty = 1;
+    mode_line_clean = 0;
+
     return 0;
 }
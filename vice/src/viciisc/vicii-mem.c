@@ -150,6 +150,7 @@ inline static void d011_store(uint8_t value)
     vicii.ysmooth = value & 0x7;
 
     vicii.regs[0x11] = value;
+    vicii.mode_line_dirty = 1;
 
     update_raster_line();
 }
@@ -177,6 +178,7 @@ inline static void d016_store(const uint8_t value)
     VICII_DEBUG_REGISTER(("Control register: $%02X", value));
 
     vicii.regs[0x16] = value;
+    vicii.mode_line_dirty = 1;
 }
 
 inline static void d017_store(const uint8_t value)
@@ -349,6 +349,7 @@ void vicii_reset_registers(void)
 void vicii_powerup(void)
 {
     memset(vicii.regs, 0, sizeof(vicii.regs));
+    vicii.mode_line_dirty = 1;
 
     vicii.irq_status = 0;
     vicii.raster_irq_line = 0;
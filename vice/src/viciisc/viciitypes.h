@@ -232,6 +232,10 @@ struct vicii_s {
     uint8_t last_color_reg;
     uint8_t last_color_value;
 
+    /* $d011/$d016 written during the current line (set by vicii-mem.c,
+       cleared by vicii-draw-cycle.c at the start of each line) */
+    uint8_t mode_line_dirty;
+
     /* Last value read by VICII during phi1.  */
     uint8_t last_read_phi1;
 
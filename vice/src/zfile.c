@@ -194,12 +194,101 @@ void zfile_shutdown(void)
 
 /* Uncompression.  */
 
+#if defined(HAVE_ZLIB) && defined(__LIBRETRO__)
+/* gzopen() opens the file with open() and would miss the frontend VFS and
+   the memory backed temp directory the archive members are extracted to, so
+   the file is read through stdio and inflated here.  Like gzread(), data
+   without a gzip header is copied as it is.  */
+static int gunzip_file(FILE *fdsrc, FILE *fddest)
+{
+    z_stream strm;
+    unsigned char in[4096];
+    unsigned char out[4096];
+    size_t len, have;
+    int ret = Z_OK;
+
+    len = fread(in, 1, sizeof(in), fdsrc);
+    if (len < 2 || in[0] != 0x1f || in[1] != 0x8b) {
+        while (len > 0) {
+            if (fwrite(in, 1, len, fddest) < len) {
+                return -1;
+            }
+            len = fread(in, 1, sizeof(in), fdsrc);
+        }
+        return 0;
+    }
+
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK) {
+        return -1;
+    }
+
+    while (len > 0 && ret != Z_STREAM_END) {
+        strm.next_in = in;
+        strm.avail_in = (uInt)len;
+        do {
+            strm.next_out = out;
+            strm.avail_out = sizeof(out);
+            ret = inflate(&strm, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END) {
+                inflateEnd(&strm);
+                return -1;
+            }
+            have = sizeof(out) - strm.avail_out;
+            if (have > 0 && fwrite(out, 1, have, fddest) < have) {
+                inflateEnd(&strm);
+                return -1;
+            }
+        } while (ret != Z_STREAM_END && (strm.avail_in > 0 || strm.avail_out == 0));
+        len = fread(in, 1, sizeof(in), fdsrc);
+    }
+
+    inflateEnd(&strm);
+
+    /* a truncated stream is an error, trailing data is ignored */
+    return (ret == Z_STREAM_END) ? 0 : -1;
+}
+#endif
+
 /* If `name' has a gzip-like extension, try to uncompress it into a temporary
    file using gzip or zlib if available.  If this succeeds, return the name
    of the temporary file; return NULL otherwise.  */
 static char *try_uncompress_with_gzip(const char *name)
 {
-#ifdef HAVE_ZLIB
+#if defined(HAVE_ZLIB) && defined(__LIBRETRO__)
+    FILE *fddest;
+    FILE *fdsrc;
+    char *tmp_name = NULL;
+    int rc;
+
+    if (!file_is_gzip(name)) {
+        return NULL;
+    }
+
+    fdsrc = fopen(name, MODE_READ);
+    if (fdsrc == NULL) {
+        return NULL;
+    }
+
+    fddest = archdep_mkstemp_fd(&tmp_name, MODE_WRITE);
+    if (fddest == NULL) {
+        fclose(fdsrc);
+        return NULL;
+    }
+
+    rc = gunzip_file(fdsrc, fddest);
+
+    fclose(fdsrc);
+    fclose(fddest);
+
+    if (rc < 0) {
+        ioutil_remove(tmp_name);
+        lib_free(tmp_name);
+        return NULL;
+    }
+
+    return tmp_name;
+#elif defined(HAVE_ZLIB)
     FILE *fddest;
     gzFile fdsrc;
     char *tmp_name = NULL;